@@ -16,25 +16,53 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
+#include <stdint.h>
 
 #define BUFFER_SIZE 512
 #define MAX_FAMILIA 50
 #define MAX_AGENTE 50
+#define MAX_SESIONES 16
+#define MARCA_MENSAJE 0xFE52FFA5u // Igual a la del controlador; cambia con el formato de MensajeAgente
 
 /* Estructura mensajes */
 typedef struct {
-	// "REGISTRO" o "RESERVA"
+	// MARCA_MENSAJE: el controlador descarta lo que no la traiga
+	uint32_t marca;
+	// "REGISTRO", "RESERVA" o "DEREGISTRO"
 	char tipo[20];
 	char nombre_agente[MAX_AGENTE];
 	char pipe_respuesta[100];
 	char familia[MAX_FAMILIA];
 	int hora_solicitada;
 	int num_personas;
+	pid_t pid_agente;
 } MensajeAgente;
 
+/* Solicitud leída del archivo junto con su resultado */
+typedef struct {
+	int num_solicitud;
+	char familia[MAX_FAMILIA];
+	int hora_solicitada;
+	int num_personas;
+	char resultado[BUFFER_SIZE];
+} Solicitud;
+
+/* Sesión que procesa un fragmento contiguo del archivo con su propio pipe de respuesta */
+typedef struct {
+	int id;
+	char pipe_respuesta[100];
+	Solicitud *solicitudes;
+	int inicio;
+	int fin;
+} Sesion;
+
 /* Variables globales */
 volatile int running = 1;
 char pipe_respuesta_agente[100];
+char nombre_agente[MAX_AGENTE] = "";
+char pipe_controlador[100] = "";
+int hora_actual = 0;
 
 /* Manejar señal de terminación */
 void manejar_senal(int sig) {
@@ -52,6 +80,7 @@ int enviar_mensaje(const char* pipe_controlador, MensajeAgente* mensaje) {
 		return -1;
 	}
 
+	mensaje->marca = MARCA_MENSAJE;
 	ssize_t bytes_escritos = write(fd, mensaje, sizeof(MensajeAgente));
 	close(fd);
 
@@ -63,9 +92,23 @@ int enviar_mensaje(const char* pipe_controlador, MensajeAgente* mensaje) {
 	return 0;
 }
 
+/* Función para avisar al controlador que el agente termina */
+void desregistrar_agente(const char* pipe_controlador, const char* nombre_agente) {
+	MensajeAgente deregistro;
+	memset(&deregistro, 0, sizeof(deregistro));
+	strncpy(deregistro.tipo, "DEREGISTRO", sizeof(deregistro.tipo));
+	strncpy(deregistro.nombre_agente, nombre_agente, sizeof(deregistro.nombre_agente) - 1);
+	strncpy(deregistro.pipe_respuesta, pipe_respuesta_agente, sizeof(deregistro.pipe_respuesta) - 1);
+	deregistro.pid_agente = getpid();
+
+	if (enviar_mensaje(pipe_controlador, &deregistro) == -1) {
+		fprintf(stderr, "Error: No se pudo desregistrar del controlador\n");
+	}
+}
+
 /* Función para recibir respuesta del controlador */
-int recibir_respuesta(char* buffer, size_t buffer_size) {
-	int fd = open(pipe_respuesta_agente, O_RDONLY);
+int recibir_respuesta(const char* pipe_respuesta, char* buffer, size_t buffer_size) {
+	int fd = open(pipe_respuesta, O_RDONLY);
 	if (fd == -1) {
 		perror("Error abriendo pipe de respuesta");
 		return -1;
@@ -82,11 +125,81 @@ int recibir_respuesta(char* buffer, size_t buffer_size) {
 	return -1;
 }
 
+/* Hilo que envía al controlador las solicitudes de su fragmento, una a la vez */
+void *hilo_sesion(void *arg) {
+	Sesion *sesion = (Sesion *)arg;
+	char buffer[BUFFER_SIZE];
+
+	for (int k = sesion->inicio; k < sesion->fin && running; k++) {
+		Solicitud *s = &sesion->solicitudes[k];
+
+		//validación hora solicitada vs hora actual
+		if (s->hora_solicitada < hora_actual) {
+			snprintf(s->resultado, sizeof(s->resultado), "RECHAZADA (hora %d ya pasó, hora actual: %d)", s->hora_solicitada, hora_actual);
+			printf("SOLICITUD %d: Familia %s - %s\n", s->num_solicitud, s->familia, s->resultado);
+			sleep(2);
+			continue;
+		}
+
+		/* preparación y envío del código de reserva */
+		MensajeAgente solicitud;
+		memset(&solicitud, 0, sizeof(solicitud));
+
+		strncpy(solicitud.tipo, "RESERVA", sizeof(solicitud.tipo));
+		strncpy(solicitud.nombre_agente, nombre_agente, sizeof(solicitud.nombre_agente));
+		strncpy(solicitud.pipe_respuesta, sesion->pipe_respuesta, sizeof(solicitud.pipe_respuesta));
+		strncpy(solicitud.familia, s->familia, sizeof(solicitud.familia));
+		solicitud.hora_solicitada = s->hora_solicitada;
+		solicitud.num_personas = s->num_personas;
+		solicitud.pid_agente = getpid();
+
+		printf("SOLICITUD %d: Familia %s, Hora %d, Personas %d -> Enviando...\n", s->num_solicitud, s->familia, s->hora_solicitada, s->num_personas);
+
+		if (enviar_mensaje(pipe_controlador, &solicitud) == -1) {
+			fprintf(stderr, "Error enviando solicitud %d\n", s->num_solicitud);
+			snprintf(s->resultado, sizeof(s->resultado), "Error enviando solicitud");
+			continue;
+		}
+
+		// Esperar para luego mostrar la respuesta de lo recibido
+		if (recibir_respuesta(sesion->pipe_respuesta, buffer, sizeof(buffer)) == 0) {
+			printf("RESPUESTA %d: %s\n", s->num_solicitud, buffer);
+			strncpy(s->resultado, buffer, sizeof(s->resultado) - 1);
+		} else {
+			printf("RESPUESTA %d: Error recibiendo respuesta\n", s->num_solicitud);
+			snprintf(s->resultado, sizeof(s->resultado), "Error recibiendo respuesta");
+		}
+
+		// El código está diseñado para esperar 2 segundos entre cada solicitud
+		sleep(2);
+	}
+
+	return NULL;
+}
+
+/* Escribir los resultados en el orden original del archivo */
+int escribir_resultados(const char *archivo_resultados, Solicitud *solicitudes, int total) {
+	FILE *salida = fopen(archivo_resultados, "w");
+	if (!salida) {
+		perror("Error creando archivo de resultados");
+		return -1;
+	}
+
+	fprintf(salida, "solicitud,familia,hora,personas,resultado\n");
+	for (int k = 0; k < total; k++) {
+		fprintf(salida, "%d,%s,%d,%d,\"%s\"\n", solicitudes[k].num_solicitud, solicitudes[k].familia,
+			solicitudes[k].hora_solicitada, solicitudes[k].num_personas,
+			solicitudes[k].resultado[0] ? solicitudes[k].resultado : "NO PROCESADA");
+	}
+
+	fclose(salida);
+	return 0;
+}
+
 int main(int argc, char *argv[]) {
-	char nombre_agente[MAX_AGENTE] = "";
 	char archivo_solicitudes[100] = "";
-	char pipe_controlador[100] = "";
-	int hora_actual = 0;
+	char archivo_resultados[100] = "";
+	int num_sesiones = 1;
 
 	// Configurar manejador de señales
 	signal(SIGINT, manejar_senal);
@@ -104,9 +217,15 @@ int main(int argc, char *argv[]) {
 		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
 			strncpy(pipe_controlador, argv[i + 1], sizeof(pipe_controlador) - 1);
 			i += 2;
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			num_sesiones = atoi(argv[i + 1]);
+			i += 2;
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			strncpy(archivo_resultados, argv[i + 1], sizeof(archivo_resultados) - 1);
+			i += 2;
 		} else {
-			fprintf(stderr, "Uso: %s -s nombre_agente -a archivo_solicitudes -p pipe_controlador\n\n", argv[0]);
-			fprintf(stderr, "Ejemplo: %s -s AgenteA -a solicitudes.csv -p /tmp/pipe_controlador\n", argv[0]);
+			fprintf(stderr, "Uso: %s -s nombre_agente -a archivo_solicitudes -p pipe_controlador [-j sesiones] [-o archivo_resultados]\n\n", argv[0]);
+			fprintf(stderr, "Ejemplo: %s -s AgenteA -a solicitudes.csv -p /tmp/pipe_controlador -j 4 -o resultados.csv\n", argv[0]);
 			return 1;
 		}
 	}
@@ -114,15 +233,26 @@ int main(int argc, char *argv[]) {
 	// Validación parámetros
 	if (strlen(nombre_agente) == 0 || strlen(archivo_solicitudes) == 0 || strlen(pipe_controlador) == 0) {
 		fprintf(stderr, "Error: Faltan parámetros requeridos\n");
-		fprintf(stderr, "Uso: %s -s nombre_agente -a archivo_solicitudes -p pipe_controlador\n", argv[0]);
+		fprintf(stderr, "Uso: %s -s nombre_agente -a archivo_solicitudes -p pipe_controlador [-j sesiones] [-o archivo_resultados]\n", argv[0]);
+		return 1;
+	}
+
+	if (num_sesiones < 1 || num_sesiones > MAX_SESIONES) {
+		fprintf(stderr, "Error: El número de sesiones debe estar entre 1 y %d\n", MAX_SESIONES);
 		return 1;
 	}
 
+	// Con varias sesiones los resultados se consolidan siempre en un archivo
+	if (strlen(archivo_resultados) == 0 && num_sesiones > 1) {
+		snprintf(archivo_resultados, sizeof(archivo_resultados), "%s.resultados", archivo_solicitudes);
+	}
+
 	printf("=== INICIANDO AGENTE DE RESERVA ===\n");
 
 	printf("Nombre agente: %s\n", nombre_agente);
 	printf("Archivo solicitudes: %s\n", archivo_solicitudes);
 	printf("Pipe controlador: %s\n", pipe_controlador);
+	printf("Sesiones paralelas: %d\n", num_sesiones);
 
 	// Crear pipe de que comunica unicamente con este agente
 	snprintf(pipe_respuesta_agente, sizeof(pipe_respuesta_agente), "/tmp/respuesta_%s_%d", nombre_agente, getpid());
@@ -136,9 +266,11 @@ int main(int argc, char *argv[]) {
 
 	/* REGISTRAR AGENTE */
 	MensajeAgente registro;
+	memset(&registro, 0, sizeof(registro));
 	strncpy(registro.tipo, "REGISTRO", sizeof(registro.tipo));
 	strncpy(registro.nombre_agente, nombre_agente, sizeof(registro.nombre_agente));
 	strncpy(registro.pipe_respuesta, pipe_respuesta_agente, sizeof(registro.pipe_respuesta));
+	registro.pid_agente = getpid();
 
 	printf("Registrando agente con controlador...\n");
 	if (enviar_mensaje(pipe_controlador, &registro) == -1) {
@@ -149,7 +281,12 @@ int main(int argc, char *argv[]) {
 
 	/* RECIBIR HORA ACTUAL */
 	char buffer[BUFFER_SIZE];
-	if (recibir_respuesta(buffer, sizeof(buffer)) == 0) {
+	if (recibir_respuesta(pipe_respuesta_agente, buffer, sizeof(buffer)) == 0) {
+		if (strncmp(buffer, "REGISTRO NEGADO", strlen("REGISTRO NEGADO")) == 0) {
+			fprintf(stderr, "Error: %s\n", buffer);
+			unlink(pipe_respuesta_agente);
+			return 1;
+		}
 		hora_actual = atoi(buffer);
 		printf("Hora actual recibida del controlador: %d\n", hora_actual);
 	} else {
@@ -162,16 +299,17 @@ int main(int argc, char *argv[]) {
 	FILE *archivo = fopen(archivo_solicitudes, "r");
 	if (!archivo) {
 		perror("Error abriendo archivo de solicitudes");
+		desregistrar_agente(pipe_controlador, nombre_agente);
 		unlink(pipe_respuesta_agente);
 		return 1;
 	}
 
 	char linea[BUFFER_SIZE];
 	int num_solicitud = 0;
+	int capacidad_solicitudes = 64;
+	Solicitud *solicitudes = malloc(capacidad_solicitudes * sizeof(Solicitud));
 
-	printf("\n=== INICIANDO PROCESAMIENTO DE SOLICITUDES ===\n");
-
-	while (fgets(linea, sizeof(linea), archivo) && running) {
+	while (solicitudes && fgets(linea, sizeof(linea), archivo)) {
 		// Limpiar línea
 		linea[strcspn(linea, "\n")] = 0;
 
@@ -179,58 +317,105 @@ int main(int argc, char *argv[]) {
 		if (strlen(linea) == 0) continue;
 
 		// Parsear línea CSV con el formato [familia,hora,personas]
-		char familia[MAX_FAMILIA];
-		int hora_solicitada, num_personas;
+		Solicitud s;
+		memset(&s, 0, sizeof(s));
 
-		if (sscanf(linea, "%[^,],%d,%d", familia, &hora_solicitada, &num_personas) != 3) {
+		if (sscanf(linea, "%49[^,],%d,%d", s.familia, &s.hora_solicitada, &s.num_personas) != 3) {
 			fprintf(stderr, "Error: Formato inválido en línea: %s\n", linea);
 			continue;
 		}
 
-		num_solicitud++;
-
-		//validación hora solicitada vs HORA ACTUALvs hora actual */
-		if (hora_solicitada < hora_actual) {
-			printf("SOLICITUD %d: Familia %s - RECHAZADA (hora %d ya pasó, hora actual: %d)\n", num_solicitud, familia, hora_solicitada, hora_actual);
-			sleep(2);
-			continue;
+		if (num_solicitud == capacidad_solicitudes) {
+			capacidad_solicitudes *= 2;
+			Solicitud *ampliado = realloc(solicitudes, capacidad_solicitudes * sizeof(Solicitud));
+			if (!ampliado) {
+				free(solicitudes);
+				solicitudes = NULL;
+				break;
+			}
+			solicitudes = ampliado;
 		}
 
-		/* preparación y envío del código de reserva */
-		MensajeAgente solicitud;
+		s.num_solicitud = ++num_solicitud;
+		solicitudes[num_solicitud - 1] = s;
+	}
 
-		strncpy(solicitud.tipo, "RESERVA", sizeof(solicitud.tipo));
-		strncpy(solicitud.nombre_agente, nombre_agente, sizeof(solicitud.nombre_agente));
-		strncpy(solicitud.pipe_respuesta, pipe_respuesta_agente, sizeof(solicitud.pipe_respuesta));
-		strncpy(solicitud.familia, familia, sizeof(solicitud.familia));
-		solicitud.hora_solicitada = hora_solicitada;
-		solicitud.num_personas = num_personas;
+	fclose(archivo);
 
-		printf("SOLICITUD %d: Familia %s, Hora %d, Personas %d -> Enviando...\n", num_solicitud, familia, hora_solicitada, num_personas);
+	if (!solicitudes) {
+		fprintf(stderr, "Error: Memoria insuficiente para cargar las solicitudes\n");
+		desregistrar_agente(pipe_controlador, nombre_agente);
+		unlink(pipe_respuesta_agente);
+		return 1;
+	}
 
-		if (enviar_mensaje(pipe_controlador, &solicitud) == -1) {
-			fprintf(stderr, "Error enviando solicitud %d\n", num_solicitud);
-			continue;
-		}
+	printf("\n=== INICIANDO PROCESAMIENTO DE SOLICITUDES ===\n");
 
-		// Esperar para luego mostrar la respuesta de lo recibido
-		if (recibir_respuesta(buffer, sizeof(buffer)) == 0) {
-			printf("RESPUESTA %d: %s\n", num_solicitud, buffer);
+	// Repartir el archivo en fragmentos contiguos, uno por sesión
+	if (num_sesiones > num_solicitud) {
+		num_sesiones = num_solicitud > 0 ? num_solicitud : 1;
+	}
+
+	Sesion sesiones[MAX_SESIONES];
+	pthread_t hilos[MAX_SESIONES];
+	int sesiones_creadas = 0;
+
+	for (int k = 0; k < num_sesiones; k++) {
+		sesiones[k].id = k;
+		sesiones[k].solicitudes = solicitudes;
+		sesiones[k].inicio = (int)((long)num_solicitud * k / num_sesiones);
+		sesiones[k].fin = (int)((long)num_solicitud * (k + 1) / num_sesiones);
+
+		// La primera sesión usa el pipe del registro; las demás crean uno propio
+		if (k == 0) {
+			strncpy(sesiones[k].pipe_respuesta, pipe_respuesta_agente, sizeof(sesiones[k].pipe_respuesta));
 		} else {
-			printf("RESPUESTA %d: Error recibiendo respuesta\n", num_solicitud);
+			snprintf(sesiones[k].pipe_respuesta, sizeof(sesiones[k].pipe_respuesta), "%s_%d", pipe_respuesta_agente, k);
+			if (mkfifo(sesiones[k].pipe_respuesta, 0666) == -1 && errno != EEXIST) {
+				perror("Error creando pipe de respuesta de la sesión");
+				break;
+			}
 		}
 
-		// El código está diseñado para esperar 2 segundos entre cada solicitud
-		sleep(2);
+		if (num_sesiones == 1) {
+			// Una sola sesión se ejecuta en el hilo principal
+			hilo_sesion(&sesiones[k]);
+			sesiones_creadas = 1;
+			break;
+		}
+
+		if (pthread_create(&hilos[k], NULL, hilo_sesion, &sesiones[k]) != 0) {
+			perror("Error creando hilo de sesión");
+			if (k > 0) {
+				unlink(sesiones[k].pipe_respuesta);
+			}
+			break;
+		}
+		sesiones_creadas++;
 	}
 
-	fclose(archivo);
+	// Esperar a todas las sesiones y borrar sus pipes
+	for (int k = 0; k < sesiones_creadas; k++) {
+		if (num_sesiones > 1) {
+			pthread_join(hilos[k], NULL);
+		}
+		if (k > 0) {
+			unlink(sesiones[k].pipe_respuesta);
+		}
+	}
+
+	if (strlen(archivo_resultados) > 0 && escribir_resultados(archivo_resultados, solicitudes, num_solicitud) == 0) {
+		printf("Resultados escritos en: %s\n", archivo_resultados);
+	}
+
+	free(solicitudes);
 
 	/* FINALIZACIÓN */
 	printf("\n=== FINALIZANDO AGENTE ===\n");
 	printf("Agente %s termina. Total solicitudes procesadas: %d\n", nombre_agente, num_solicitud);
 
-	// Limpiar pipe antes de cerrar el código
+	// Avisar al controlador y limpiar pipe antes de cerrar el código
+	desregistrar_agente(pipe_controlador, nombre_agente);
 	unlink(pipe_respuesta_agente);
 
 	return 0;
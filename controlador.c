@@ -14,21 +14,41 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #define MAX_AGENTES 50
+#define TABLA_AGENTES 128 // Potencia de 2 mayor que MAX_AGENTES para mantener baja la ocupación
 #define MAX_RESERVAS 1000
 #define MAX_FAMILIA 50
 #define MAX_AGENTE 50
 #define BUFFER_SIZE 512
+#define MAX_DIVERGENCIAS 10
+#define HORAS_POR_RESERVA 2
+#define TAM_CACHE_ADMISION 256 // Potencia de 2
+#define MAX_PARTICIONES 8
+#define MAX_PENDIENTES 256 // Más solicitudes de las que caben en el pipe de una partición
+#define ESPERA_PARTICION_MS 2000
+#define HORAS_DIA 25 // Franjas 0..24: hora_fin puede valer 24
+#define MARCA_MENSAJE 0xFE52FFA5u // Cambia con el formato de MensajeAgente; FF y FE no aparecen en texto UTF-8
 
 // Estructuras de datos
 typedef struct Agente {
 	char nombre[MAX_AGENTE];
 	char pipe_respuesta[100];
-	struct Agente *siguiente;
+	pid_t pid;
+	unsigned int hash;
+	// 0: ranura libre, 1: ranura ocupada
+	int ocupado;
 } Agente;
 
 typedef struct Reserva {
@@ -41,39 +61,221 @@ typedef struct Reserva {
 	struct Reserva *siguiente;
 } Reserva;
 
-typedef struct EstadoHora {
-	int capacidad_actual;
-	int capacidad_maxima;
-	int personas_entrando;
-	int personas_saliendo;
-	Reserva *reservas_activas;
-} EstadoHora;
+/* Estado de las horas en estructura de arreglos: la búsqueda de cupo solo recorre
+ * capacidad_actual (y la capacidad de la configuración), ambos contiguos */
+typedef struct EstadoHoras {
+	int capacidad_actual[HORAS_DIA];
+	int personas_entrando[HORAS_DIA];
+	int personas_saliendo[HORAS_DIA];
+	Reserva *reservas_activas[HORAS_DIA];
+} EstadoHoras;
+
+/* Última decisión de cupo para una clave (hora solicitada, personas).
+ * Válida mientras no cambie la versión de la configuración: sin cancelaciones la
+ * ocupación solo crece, así que una ventana que no cabía sigue sin caber */
+typedef struct EntradaCacheAdmision {
+	int hora_solicitada;
+	int num_personas;
+	// Primera ventana factible encontrada, -1 si no había ninguna
+	int hora_ventana;
+	// Versión de la configuración con que se calculó, 0: entrada vacía
+	unsigned long version;
+} EntradaCacheAdmision;
+
+/* Marca en la máscara las franjas con cupo libre >= num_personas */
+typedef void (*FuncionMascaraCupo)(const int *capacidad, const int *ocupado, int n, int num_personas, uint64_t *mascara);
 
+/* Mensaje de un agente. En el pipe del controlador solo los delimita su tamaño, así que
+ * la marca permite detectar a un escritor con otro formato y volver a alinearse */
 typedef struct MensajeAgente {
+	uint32_t marca;
 	char tipo[20];
 	char nombre_agente[MAX_AGENTE];
 	char pipe_respuesta[100];
 	char familia[MAX_FAMILIA];
 	int hora_solicitada;
 	int num_personas;
+	pid_t pid_agente;
 } MensajeAgente;
 
+/* Mensaje del coordinador a la partición dueña de la hora solicitada. Viaja por el
+ * pipe de solicitudes de la partición, que solo escribe el coordinador, así que las
+ * recargas y los cambios de hora quedan ordenados con las solicitudes */
+typedef struct SolicitudParticion {
+	// 1: RESERVA (la partición responde directo al agente), 2: AVANZAR, 3: CONFIGURAR
+	int tipo;
+	int hora_actual;
+	// CONFIGURAR: horario y capacidad de la nueva versión
+	int hora_fin;
+	int capacidad[HORAS_DIA];
+	MensajeAgente mensaje;
+} SolicitudParticion;
+
+/* Petición sobre las horas de una partición. Llega al pipe de servicio de la dueña y
+ * la contesta su hilo de servicio por el pipe de respuestas de quien pregunta. Lleva la
+ * capacidad vigente de todas las horas para no depender del orden de las recargas */
+typedef struct MensajeParticion {
+	// 1: CUPO, 2: RESERVAR, 3: PREPARAR, 4: CONFIRMAR, 5: ABORTAR, 6: ESTADO
+	int tipo;
+	// Quien pregunta: índice de la partición, o num_particiones si es el coordinador
+	int origen;
+	// Se devuelve en la respuesta para descartar las de peticiones ya vencidas
+	unsigned int secuencia;
+	int hora;
+	int num_personas;
+	int hora_fin;
+	int capacidad[HORAS_DIA];
+} MensajeParticion;
+
+typedef struct RespuestaParticion {
+	unsigned int secuencia;
+	// 1: operación aplicada, 0: sin cupo o rechazada
+	int ok;
+	// CUPO: bit h activo si la hora h (propia) tiene cupo libre >= num_personas
+	uint32_t mascara;
+	// ESTADO: contadores de las horas propias y solicitudes decididas por la partición
+	int capacidad_actual[HORAS_DIA];
+	int personas_entrando[HORAS_DIA];
+	int personas_saliendo[HORAS_DIA];
+	int aceptadas;
+	int reprogramadas;
+	int rechazadas;
+} RespuestaParticion;
+
+/* Solicitud entregada a una partición, guardada para responderla si el proceso
+ * termina antes de hacerlo */
+typedef struct SolicitudPendiente {
+	char pipe_respuesta[100];
+	char familia[MAX_FAMILIA];
+} SolicitudPendiente;
+
+/* Proceso hijo dueño de las horas [desde, hasta] y sus pipes: solicitudes
+ * (coordinador -> hilo de admisión) y servicio (cualquiera -> hilo de servicio) */
+typedef struct Particion {
+	pid_t pid;
+	int desde;
+	int hasta;
+	// 0 cuando el proceso terminó o dejó de responder
+	int activa;
+	int fd_solicitudes;
+	int fd_servicio;
+	char pipe_solicitudes[140];
+	char pipe_servicio[140];
+	// Últimos contadores recibidos con ESTADO
+	int aceptadas;
+	int reprogramadas;
+	int rechazadas;
+	// Solicitudes enviadas; las de número >= atendidas[p] siguen sin respuesta
+	unsigned long enviadas;
+	SolicitudPendiente pendientes[MAX_PENDIENTES];
+} Particion;
+
+/* Configuración modificable en caliente. Cada versión es inmutable una vez publicada */
+typedef struct Configuracion {
+	int hora_fin;
+	int segundos_por_hora;
+	// Mayor capacidad entre todas las horas
+	int capacidad_maxima;
+	int capacidad_hora[HORAS_DIA];
+	unsigned long version;
+	// Versiones retiradas, se liberan al terminar
+	struct Configuracion *anterior;
+} Configuracion;
+
+/* Formato binario de la traza: una cabecera seguida de un registro por mensaje recibido */
+typedef struct CabeceraTraza {
+	// "TRZ2"
+	char magia[4];
+	int32_t hora_inicio;
+	int32_t hora_fin;
+	int32_t segundos_por_hora;
+	int32_t capacidad_maxima;
+} CabeceraTraza;
+
+typedef struct RegistroTraza {
+	// Nanosegundos desde el inicio de la grabación
+	uint64_t marca_ns;
+	int32_t hora_solicitada;
+	int32_t num_personas;
+	// Versión de la configuración con que se decidió (o que publicó la recarga)
+	uint32_t version;
+	int8_t hora_actual;
+	int8_t hora_asignada;
+	// 1: REGISTRO, 2: RESERVA, 3: DEREGISTRO, 0: desconocido,
+	// 4: capacidad de la hora hora_solicitada = num_personas (recarga),
+	// 5: hora_fin = hora_solicitada y segundos_por_hora = num_personas (recarga)
+	uint8_t tipo;
+	// 0: sin decisión, 1: aceptada, 2: reprogramada, 3: rechazada
+	uint8_t decision;
+	char familia[MAX_FAMILIA];
+	char nombre_agente[MAX_AGENTE];
+} RegistroTraza;
+
 /* Variables globales */
-EstadoHora estado_horas[24];
-Agente *lista_agentes = NULL;
+EstadoHoras estado_horas;
+// Tabla hash de direccionamiento abierto (sondeo lineal) indexada por nombre de agente
+Agente tabla_agentes[TABLA_AGENTES];
+int num_agentes = 0;
 Reserva *lista_reservas = NULL;
 
 pthread_mutex_t mutex_agentes = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_reservas = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex_horas = PTHREAD_MUTEX_INITIALIZER;
+// Serializa solo a quienes publican configuraciones; los lectores nunca lo toman
+pthread_mutex_t mutex_configuracion = PTHREAD_MUTEX_INITIALIZER;
 
 volatile int running = 1;
+// 1 mientras el hilo receptor no haya salido de su bucle
+volatile int receptor_activo = 0;
+// Permiten interrumpir la espera del reloj al terminar
+pthread_mutex_t mutex_reloj = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cond_reloj = PTHREAD_COND_INITIALIZER;
 volatile int hora_actual = 7;
 int hora_inicio = 7;
 int hora_fin = 19;
 int segundos_por_hora = 10;
 int capacidad_maxima = 100;
 char pipe_controlador[100] = "/tmp/pipe_controlador";
+char archivo_configuracion[100] = "";
+
+/* Configuración vigente: se publica con un intercambio atómico de puntero (estilo RCU) */
+Configuracion *config_actual = NULL;
+
+/* Particiones de horas (modo coordinador). Con 0 particiones el controlador
+ * guarda todo el estado. En cada proceso solo un hilo hace consultas a las
+ * particiones (el reloj en el coordinador, el de admisión en las particiones),
+ * así que cada uno tiene un único pipe de respuestas */
+Particion particiones[MAX_PARTICIONES];
+int num_particiones = 0;
+// -1 en el coordinador y en modo clásico; en un hijo, el índice de su partición
+int particion_propia = -1;
+// Pipes de respuestas por origen; el del coordinador va en la posición num_particiones
+char pipes_respuestas[MAX_PARTICIONES + 1][140];
+// Extremos de escritura hacia cada origen (los usa el hilo de servicio)
+int fd_respuestas[MAX_PARTICIONES + 1];
+int fd_mis_respuestas = -1;
+unsigned int secuencia_peticiones = 0;
+// Cupo retenido por un PREPARAR de cada origen, pendiente de CONFIRMAR o ABORTAR
+MensajeParticion retenciones[MAX_PARTICIONES + 1];
+int retencion_activa[MAX_PARTICIONES + 1];
+// Solicitudes respondidas por cada partición, en memoria compartida con los hijos
+unsigned long *atendidas = NULL;
+// Protege activa y las solicitudes pendientes de cada partición en el coordinador
+pthread_mutex_t mutex_particiones = PTHREAD_MUTEX_INITIALIZER;
+
+/* Caché de decisiones de admisión (protegida por mutex_horas) */
+EntradaCacheAdmision cache_admision[TAM_CACHE_ADMISION];
+int aciertos_cache = 0;
+int fallos_cache = 0;
+
+/* Kernel de búsqueda de cupo elegido según la CPU al iniciar */
+FuncionMascaraCupo mascara_cupo = NULL;
+
+/* Grabación de la traza (opcional). La escriben el hilo receptor y, en las recargas,
+ * el hilo de señales; cada fwrite toma el cerrojo del FILE, así que los registros no
+ * se mezclan, y el orden entre ambos lo resuelve la versión guardada en cada uno */
+FILE *archivo_traza = NULL;
+struct timespec inicio_traza;
 
 /* Estadísticas para reporte final */
 int solicitudes_aceptadas = 0;
@@ -81,41 +283,124 @@ int solicitudes_reprogramadas = 0;
 int solicitudes_rechazadas = 0;
 
 /* Prototipos de funciones */
-void manejar_senal(int sig);
+void detener_simulacion();
+void despertar_receptor();
+int esperar_reloj(int segundos);
 void inicializar_sistema();
+void inicializar_horas();
 void limpiar_sistema();
 void *hilo_receptor_agentes(void *arg);
+int leer_mensaje_agente(int fd, MensajeAgente *mensaje);
 void *hilo_reloj_simulacion(void *arg);
 void procesar_mensaje_agente(MensajeAgente *mensaje);
 void registrar_agente(MensajeAgente *mensaje);
+void desregistrar_agente(MensajeAgente *mensaje);
+unsigned int hash_agente(const char *nombre);
+int buscar_agente(const char *nombre);
+int insertar_agente(const char *nombre);
+void eliminar_agente(int indice);
+int agente_vivo(const Agente *agente);
+void borrar_pipe_agente(const char *ruta);
+void purgar_agentes_inactivos();
 void procesar_solicitud_reserva(MensajeAgente *mensaje);
-int verificar_disponibilidad(int hora_inicio, int num_personas);
-int encontrar_hora_alternativa(int hora_solicitada, int num_personas);
+int decidir_reserva(const Configuracion *cfg, int hora_decision, MensajeAgente *mensaje, char *respuesta, size_t tam_respuesta, int *hora_asignada);
+int abrir_traza(const char *archivo);
+void registrar_traza(MensajeAgente *mensaje, unsigned long version, int hora_decision, int decision, int hora_asignada);
+void escribir_registro_traza(MensajeAgente *mensaje, int tipo, unsigned long version, int hora_decision, int decision, int hora_asignada);
+int registro_traza_valido(const RegistroTraza *registro);
+int reproducir_traza(const char *archivo);
+int reservar_ventana(const Configuracion *cfg, int hora_decision, int hora_solicitada, int num_personas);
+int ventana_disponible(const Configuracion *cfg, int hora, int num_personas);
+int encontrar_hora_alternativa(const Configuracion *cfg, int hora_decision, int hora_solicitada, int num_personas);
+void seleccionar_kernel_cupo();
+int buscar_ventana(const int *capacidad, const int *ocupado, int desde, int hasta, int ancho, int limite, int num_personas);
+int buscar_ventana_escalar(const int *capacidad, const int *ocupado, int desde, int hasta, int ancho, int limite, int num_personas);
+void ocupar_ventana(int hora, int hora_fin, int num_personas);
+int iniciar_particiones(int cantidad);
+int abrir_pipe_escritura(const char *ruta);
+void ejecutar_particion(int indice);
+void *hilo_servicio_particion(void *arg);
+void liberar_retencion(int origen, int confirmar);
+void atender_peticion_particion(const MensajeParticion *peticion, RespuestaParticion *respuesta);
+void detener_particiones();
+int particion_de_hora(int hora);
+void enrutar_solicitud(MensajeAgente *mensaje);
+void enviar_a_particiones(SolicitudParticion *solicitud);
+void marcar_particion_caida(int indice, const char *motivo);
+void revisar_particiones();
+void responder_sin_espera(const char *pipe_respuesta, const char *mensaje);
+int consultar_particion(int indice, MensajeParticion *peticion, RespuestaParticion *respuesta);
+void avisar_particion(int indice, MensajeParticion *peticion);
+int reservar_ventana_particiones(const Configuracion *cfg, int hora, int num_personas);
+int reservar_en_particiones(const Configuracion *cfg, int hora_decision, int hora_solicitada, int num_personas);
+int sincronizar_particiones(int hora_avance);
+int medir_busqueda_cupo(int iteraciones);
+Configuracion *leer_configuracion();
+Configuracion *crear_configuracion_inicial();
+void publicar_configuracion(Configuracion *nueva);
+int cargar_archivo_configuracion(const char *archivo, Configuracion *cfg);
+int recargar_configuracion();
+void *hilo_senales(void *arg);
+void liberar_configuraciones();
 void responder_agente(const char *pipe_respuesta, const char *mensaje);
 void avanzar_hora_simulacion();
 void generar_reporte_final();
 void agregar_reserva(const char *familia, const char *agente, int hora_entrada, int num_personas, int estado);
 
-/* Manejar señal de terminación */
-void manejar_senal(int sig) {
-	printf("\n=====| SEÑAL DE TERMINACIÓN RECIBIDA |=====\n");
+/* Pedir a los hilos que terminen y despertar al reloj si está esperando */
+void detener_simulacion() {
+	pthread_mutex_lock(&mutex_reloj);
 	running = 0;
-	generar_reporte_final();
-	limpiar_sistema();
-	exit(0);
+	pthread_cond_broadcast(&cond_reloj);
+	pthread_mutex_unlock(&mutex_reloj);
+}
+
+/* Desbloquear al hilo receptor si espera en read: como el receptor mantiene el pipe
+ * abierto también para escritura nunca lee EOF, así que se le envía un mensaje vacío
+ * que descarta al ver running en 0 */
+void despertar_receptor() {
+	MensajeAgente vacio;
+	memset(&vacio, 0, sizeof(vacio));
+	vacio.marca = MARCA_MENSAJE;
+
+	int fd = open(pipe_controlador, O_WRONLY | O_NONBLOCK);
+	if (fd != -1) {
+		// EAGAIN: pipe lleno, el receptor tiene mensajes pendientes y revisará running igual
+		if (write(fd, &vacio, sizeof(vacio)) == -1 && errno != EAGAIN) {
+			perror("Error despertando al receptor");
+		}
+		close(fd);
+	}
+}
+
+/* Esperar los segundos de una hora simulada o hasta que se pida terminar. Devuelve running */
+int esperar_reloj(int segundos) {
+	struct timespec limite;
+	clock_gettime(CLOCK_REALTIME, &limite);
+	limite.tv_sec += segundos;
+
+	pthread_mutex_lock(&mutex_reloj);
+	while (running && pthread_cond_timedwait(&cond_reloj, &mutex_reloj, &limite) != ETIMEDOUT);
+	pthread_mutex_unlock(&mutex_reloj);
+
+	return running;
+}
+
+/* Inicializar estado de las horas */
+void inicializar_horas() {
+	for (int i = 0; i < HORAS_DIA; i++) {
+		estado_horas.capacidad_actual[i] = 0;
+		estado_horas.personas_entrando[i] = 0;
+		estado_horas.personas_saliendo[i] = 0;
+		estado_horas.reservas_activas[i] = NULL;
+	}
 }
 
 /* Inicializar sistema */
 void inicializar_sistema() {
 	printf("\nInicializando el sistema...\n");
 
-	for (int i = 0; i < 24; i++) {
-		estado_horas[i].capacidad_actual = 0;
-		estado_horas[i].capacidad_maxima = capacidad_maxima;
-		estado_horas[i].personas_entrando = 0;
-		estado_horas[i].personas_saliendo = 0;
-		estado_horas[i].reservas_activas = NULL;
-	}
+	inicializar_horas();
 
 	// Crear pipe del controlador
 	if (mkfifo(pipe_controlador, 0666) == -1 && errno != EEXIST) {
@@ -130,13 +415,11 @@ void inicializar_sistema() {
 void limpiar_sistema() {
 	printf("Limpiando recursos del sistema...\n");
 
-	// Limpiar lista de agentes
-	Agente *agente_actual = lista_agentes;
-	while (agente_actual != NULL) {
-		Agente *temp = agente_actual;
-	agente_actual = agente_actual->siguiente;
-	free(temp);
-	}
+	// Limpiar tabla de agentes
+	pthread_mutex_lock(&mutex_agentes);
+	memset(tabla_agentes, 0, sizeof(tabla_agentes));
+	num_agentes = 0;
+	pthread_mutex_unlock(&mutex_agentes);
 
 	// Limpiar lista de reservas
 	Reserva *reserva_actual = lista_reservas;
@@ -146,7 +429,15 @@ void limpiar_sistema() {
 		free(temp);
 	}
 
-	// Eliminar pipe
+	detener_particiones();
+
+	// Cerrar traza: solo se llega aquí sin hilos que puedan seguir escribiéndola
+	if (archivo_traza != NULL) {
+		fclose(archivo_traza);
+		archivo_traza = NULL;
+	}
+
+	// Eliminar pipe (normalmente ya lo borró el receptor)
 	unlink(pipe_controlador);
 }
 
@@ -154,53 +445,84 @@ void limpiar_sistema() {
 void *hilo_receptor_agentes(void *arg) {
 	printf("Hilo receptor de agentes iniciado\n");
 
-	while (running) {
-		int fd = open(pipe_controlador, O_RDONLY);
-		if (fd == -1) {
-			if (running) {
-				perror("Error abriendo pipe del controlador");
-			}
-			break;
-		}
-
+	// Abrir en O_RDWR una sola vez: si el receptor cerrara y reabriera el pipe al leer
+	// EOF, un agente que lo abre justo antes del close escribe en un pipe que se queda
+	// sin lectores y su mensaje se pierde. Con O_RDWR el pipe nunca queda sin lector
+	int fd = open(pipe_controlador, O_RDWR);
+	if (fd == -1) {
+		perror("Error abriendo pipe del controlador");
+	} else {
 		MensajeAgente mensaje;
-		ssize_t bytes_leidos = read(fd, &mensaje, sizeof(mensaje));
-		close(fd);
-
-		if (bytes_leidos == sizeof(mensaje)) {
+		while (running && leer_mensaje_agente(fd, &mensaje)) {
+			if (!running) break;
 			procesar_mensaje_agente(&mensaje);
-		} else if (bytes_leidos > 0) {
-			fprintf(stderr, "Error: Mensaje de tamaño incorrecto\n");
 		}
+
+		// Borrar el pipe antes de cerrarlo: un agente que lo abra después de close pero
+		// antes del unlink de limpiar_sistema quedaría bloqueado en open para siempre.
+		// Así, o lo abre mientras aún hay lector, o recibe ENOENT
+		unlink(pipe_controlador);
+		close(fd);
 	}
 
+	receptor_activo = 0;
 	printf("Hilo receptor de agentes terminado\n");
 	return NULL;
 }
 
+/* Leer el siguiente mensaje con la marca vigente. Devuelve 0 si falla read.
+ * Un escritor con otro formato (por ejemplo un agente compilado con otra versión de
+ * MensajeAgente) desalinearía todos los mensajes siguientes: si lo leído no empieza con
+ * la marca se descartan bytes hasta la próxima y el mensaje se completa desde ahí */
+int leer_mensaje_agente(int fd, MensajeAgente *mensaje) {
+	unsigned char *bytes = (unsigned char *)mensaje;
+	uint32_t marca = MARCA_MENSAJE;
+	size_t llenos = 0;
+
+	while (llenos < sizeof(*mensaje)) {
+		ssize_t leidos = read(fd, bytes + llenos, sizeof(*mensaje) - llenos);
+		if (leidos <= 0) {
+			return 0;
+		}
+		llenos += leidos;
+
+		size_t inicio = 0;
+		while (inicio + sizeof(marca) <= llenos && memcmp(bytes + inicio, &marca, sizeof(marca)) != 0) {
+			inicio++;
+		}
+		if (inicio + sizeof(marca) > llenos) {
+			// Sin marca completa: conservar la cola, que puede ser el comienzo de una
+			inicio = llenos >= sizeof(marca) ? llenos - (sizeof(marca) - 1) : 0;
+		}
+
+		if (inicio > 0) {
+			fprintf(stderr, "Error: %zu bytes con formato desconocido descartados (¿agente de otra versión?)\n", inicio);
+			memmove(bytes, bytes + inicio, llenos - inicio);
+			llenos -= inicio;
+		}
+	}
+
+	return 1;
+}
+
 /* Hilo del reloj de simulación */
 void *hilo_reloj_simulacion(void *arg) {
 	printf("Hilo del reloj de simulación iniciado\n");
-	printf("Hora inicial: %d, Hora final: %d, Segundos por hora: %d\n", hora_inicio, hora_fin, segundos_por_hora);
+	printf("Hora inicial: %d, Hora final: %d, Segundos por hora: %d\n", hora_inicio, leer_configuracion()->hora_fin, leer_configuracion()->segundos_por_hora);
 
-	while (running && hora_actual <= hora_fin) {
-		sleep(segundos_por_hora);
-
-		if (!running) break;
+	// La hora final y la velocidad se releen en cada vuelta para aplicar recargas
+	while (running && hora_actual <= leer_configuracion()->hora_fin) {
+		if (!esperar_reloj(leer_configuracion()->segundos_por_hora)) break;
 
 		pthread_mutex_lock(&mutex_horas);
 		avanzar_hora_simulacion();
 		pthread_mutex_unlock(&mutex_horas);
-	}
-
-	printf("Hilo del reloj de simulación terminado\n");
 
-	// Generar reporte final cuando termina la simulación
-	if (hora_actual > hora_fin) {
-		generar_reporte_final();
-		running = 0;
+		// Desalojar agentes cuyo proceso ya no existe
+		purgar_agentes_inactivos();
 	}
 
+	printf("Hilo del reloj de simulación terminado\n");
 	return NULL;
 }
 
@@ -210,288 +532,1926 @@ void procesar_mensaje_agente(MensajeAgente *mensaje) {
 
 	if (strcmp(mensaje->tipo, "REGISTRO") == 0) {
 		registrar_agente(mensaje);
+		registrar_traza(mensaje, leer_configuracion()->version, hora_actual, 0, -1);
+	} else if (strcmp(mensaje->tipo, "DEREGISTRO") == 0) {
+		desregistrar_agente(mensaje);
+		registrar_traza(mensaje, leer_configuracion()->version, hora_actual, 0, -1);
 	} else if (strcmp(mensaje->tipo, "RESERVA") == 0) {
+		// Verificar que el agente que envía la solicitud esté registrado
+		pthread_mutex_lock(&mutex_agentes);
+		int indice = buscar_agente(mensaje->nombre_agente);
+		pthread_mutex_unlock(&mutex_agentes);
+
+		if (indice == -1) {
+			fprintf(stderr, "Advertencia: Solicitud de agente no registrado: %s\n", mensaje->nombre_agente);
+		}
+
 		procesar_solicitud_reserva(mensaje);
 	} else {
 		fprintf(stderr, "Error: Tipo de mensaje desconocido: %s\n", mensaje->tipo);
+		registrar_traza(mensaje, leer_configuracion()->version, hora_actual, 0, -1);
+	}
+}
+
+/* Hash FNV-1a del nombre del agente */
+unsigned int hash_agente(const char *nombre) {
+	unsigned int hash = 2166136261u;
+
+	for (const unsigned char *c = (const unsigned char *)nombre; *c != '\0'; c++) {
+		hash ^= *c;
+		hash *= 16777619u;
 	}
+
+	return hash;
+}
+
+/* Buscar agente en la tabla (requiere mutex_agentes). Devuelve el índice o -1 */
+int buscar_agente(const char *nombre) {
+	unsigned int hash = hash_agente(nombre);
+	int indice = hash & (TABLA_AGENTES - 1);
+
+	// El sondeo termina en la primera ranura libre: el borrado no deja huecos en las cadenas
+	for (int n = 0; n < TABLA_AGENTES && tabla_agentes[indice].ocupado; n++) {
+		if (tabla_agentes[indice].hash == hash && strcmp(tabla_agentes[indice].nombre, nombre) == 0) {
+			return indice;
+		}
+		indice = (indice + 1) & (TABLA_AGENTES - 1);
+	}
+
+	return -1;
+}
+
+/* Reservar una ranura nueva para el agente (requiere mutex_agentes). Devuelve el índice o -1 si no hay cupo */
+int insertar_agente(const char *nombre) {
+	if (num_agentes >= MAX_AGENTES) {
+		return -1;
+	}
+
+	unsigned int hash = hash_agente(nombre);
+	int indice = hash & (TABLA_AGENTES - 1);
+
+	while (tabla_agentes[indice].ocupado) {
+		indice = (indice + 1) & (TABLA_AGENTES - 1);
+	}
+
+	memset(&tabla_agentes[indice], 0, sizeof(Agente));
+	strncpy(tabla_agentes[indice].nombre, nombre, sizeof(tabla_agentes[indice].nombre) - 1);
+	tabla_agentes[indice].hash = hash;
+	tabla_agentes[indice].ocupado = 1;
+	num_agentes++;
+
+	return indice;
+}
+
+/* Eliminar agente de la tabla con desplazamiento hacia atrás (requiere mutex_agentes) */
+void eliminar_agente(int indice) {
+	int hueco = indice;
+	int j = indice;
+
+	tabla_agentes[hueco].ocupado = 0;
+	num_agentes--;
+
+	// Mover hacia el hueco las entradas siguientes de la cadena que quedarían inalcanzables
+	while (1) {
+		j = (j + 1) & (TABLA_AGENTES - 1);
+		if (!tabla_agentes[j].ocupado) break;
+
+		int ideal = tabla_agentes[j].hash & (TABLA_AGENTES - 1);
+		int alcanzable = (hueco <= j) ? (hueco < ideal && ideal <= j) : (hueco < ideal || ideal <= j);
+
+		if (!alcanzable) {
+			tabla_agentes[hueco] = tabla_agentes[j];
+			tabla_agentes[j].ocupado = 0;
+			hueco = j;
+		}
+	}
+}
+
+/* Verificar si el proceso del agente sigue en ejecución */
+int agente_vivo(const Agente *agente) {
+	if (agente->pid <= 0) {
+		// Sin pid no se puede comprobar: se asume vivo mientras exista su pipe
+		return access(agente->pipe_respuesta, F_OK) == 0;
+	}
+
+	return kill(agente->pid, 0) == 0 || errno != ESRCH;
+}
+
+/* Borrar el pipe de respuesta que dejó un agente. La ruta llega en un mensaje del pipe
+ * del controlador, que cualquier proceso local puede escribir, así que solo se borra si
+ * sigue siendo un FIFO (lstat: un enlace simbólico hacia un FIFO tampoco se borra) */
+void borrar_pipe_agente(const char *ruta) {
+	struct stat info;
+
+	if (lstat(ruta, &info) == -1) {
+		return;
+	}
+
+	if (!S_ISFIFO(info.st_mode)) {
+		fprintf(stderr, "Advertencia: %s no es un pipe, no se borra\n", ruta);
+		return;
+	}
+
+	unlink(ruta);
 }
 
 // Registrar nuevo agente
 void registrar_agente(MensajeAgente *mensaje) {
+	char respuesta[BUFFER_SIZE];
+	int aceptado = 1;
+
 	pthread_mutex_lock(&mutex_agentes);
 
-	// Agregar agente a la lista
-	Agente *nuevo_agente = malloc(sizeof(Agente));
-	strncpy(nuevo_agente->nombre, mensaje->nombre_agente, sizeof(nuevo_agente->nombre));
-	strncpy(nuevo_agente->pipe_respuesta, mensaje->pipe_respuesta, sizeof(nuevo_agente->pipe_respuesta));
-	nuevo_agente->siguiente = lista_agentes;
-	lista_agentes = nuevo_agente;
+	int indice = buscar_agente(mensaje->nombre_agente);
+
+	if (indice != -1 && tabla_agentes[indice].pid != mensaje->pid_agente && agente_vivo(&tabla_agentes[indice])) {
+		// Nombre duplicado: otro proceso activo ya usa este nombre
+		snprintf(respuesta, sizeof(respuesta), "REGISTRO NEGADO: El agente %s ya está registrado (pid %d)", mensaje->nombre_agente, (int)tabla_agentes[indice].pid);
+		aceptado = 0;
+	} else {
+		if (indice == -1) {
+			indice = insertar_agente(mensaje->nombre_agente);
+		} else if (strcmp(tabla_agentes[indice].pipe_respuesta, mensaje->pipe_respuesta) != 0) {
+			// El proceso anterior con este nombre terminó sin borrar su pipe
+			borrar_pipe_agente(tabla_agentes[indice].pipe_respuesta);
+		}
+
+		if (indice == -1) {
+			snprintf(respuesta, sizeof(respuesta), "REGISTRO NEGADO: Se alcanzó el máximo de agentes (%d)", MAX_AGENTES);
+			aceptado = 0;
+		} else {
+			// Un re-registro del mismo nombre reutiliza la entrada existente
+			strncpy(tabla_agentes[indice].pipe_respuesta, mensaje->pipe_respuesta, sizeof(tabla_agentes[indice].pipe_respuesta) - 1);
+			tabla_agentes[indice].pid = mensaje->pid_agente;
+
+			// Responder con hora actual
+			snprintf(respuesta, sizeof(respuesta), "%d", hora_actual);
+		}
+	}
 
 	pthread_mutex_unlock(&mutex_agentes);
 
-	// Responder con hora actual
-	char respuesta[BUFFER_SIZE];
-	snprintf(respuesta, sizeof(respuesta), "%d", hora_actual);
 	responder_agente(mensaje->pipe_respuesta, respuesta);
 
-	printf("NUEVO AGENTE REGISTRADO: %s (Pipe: %s)\n", mensaje->nombre_agente, mensaje->pipe_respuesta);
+	if (aceptado) {
+		printf("NUEVO AGENTE REGISTRADO: %s (Pipe: %s)\n", mensaje->nombre_agente, mensaje->pipe_respuesta);
+	} else {
+		printf("%s\n", respuesta);
+	}
+}
+
+// Eliminar agente que termina su ejecución
+void desregistrar_agente(MensajeAgente *mensaje) {
+	pthread_mutex_lock(&mutex_agentes);
+
+	int indice = buscar_agente(mensaje->nombre_agente);
+	// Solo el proceso dueño del registro puede eliminarlo
+	int eliminado = indice != -1 && tabla_agentes[indice].pid == mensaje->pid_agente;
+	if (eliminado) {
+		eliminar_agente(indice);
+	}
+
+	pthread_mutex_unlock(&mutex_agentes);
+
+	if (eliminado) {
+		printf("AGENTE DESREGISTRADO: %s\n", mensaje->nombre_agente);
+	} else {
+		fprintf(stderr, "Error: Desregistro de agente desconocido: %s\n", mensaje->nombre_agente);
+	}
 }
 
-// Procesar solicitud de reserva
-void procesar_solicitud_reserva(MensajeAgente *mensaje) {
-	printf("SOLICITUD RECIBIDA: Agente %s - Familia %s, Hora %d, Personas %d\n", mensaje->nombre_agente, mensaje->familia, mensaje->hora_solicitada, mensaje->num_personas);
+/* Desalojar agentes cuyo proceso terminó sin desregistrarse */
+void purgar_agentes_inactivos() {
+	pthread_mutex_lock(&mutex_agentes);
 
-	char respuesta[BUFFER_SIZE];
+	int i = 0;
+	while (i < TABLA_AGENTES) {
+		if (tabla_agentes[i].ocupado && !agente_vivo(&tabla_agentes[i])) {
+			printf("AGENTE INACTIVO DESALOJADO: %s\n", tabla_agentes[i].nombre);
+
+			// El agente no alcanzó a borrar su pipe de respuesta
+			borrar_pipe_agente(tabla_agentes[i].pipe_respuesta);
+			eliminar_agente(i);
+
+			// El desplazamiento pudo mover otra entrada a esta ranura: revisarla de nuevo
+			continue;
+		}
+		i++;
+	}
+
+	pthread_mutex_unlock(&mutex_agentes);
+}
+
+// Decidir la admisión de una solicitud y aplicarla sobre el estado de las horas.
+// Devuelve el estado de la reserva (1: aceptada, 2: reprogramada, 3: rechazada)
+// La decisión completa usa una sola versión de la configuración (cfg) y una sola lectura
+// de la hora (hora_decision): el reloj puede avanzar mientras se decide, y la traza
+// debe guardar la hora que realmente se usó
+int decidir_reserva(const Configuracion *cfg, int hora_decision, MensajeAgente *mensaje, char *respuesta, size_t tam_respuesta, int *hora_asignada) {
+	int decision = 3;
+	*hora_asignada = -1;
+
+	int hora_fin = cfg->hora_fin;
+	int capacidad_maxima = cfg->capacidad_maxima;
 
 	// *VALIDACIÓN 1: Hora fuera del rango de simulación*
 	if (mensaje->hora_solicitada > hora_fin) {
-		snprintf(respuesta, sizeof(respuesta),
+		snprintf(respuesta, tam_respuesta,
 		"RESERVA NEGADA: Familia %s - Hora solicitada (%d) fuera del horario del parque (hora fin: %d)",
                  mensaje->familia, mensaje->hora_solicitada, hora_fin);
 		solicitudes_rechazadas++;
 	}
 	// *VALIDACIÓN 2: Número de personas excede capacidad máxima*
 	else if (mensaje->num_personas > capacidad_maxima) {
-		snprintf(respuesta, sizeof(respuesta),
+		snprintf(respuesta, tam_respuesta,
 		"RESERVA NEGADA: Familia %s - Número de personas (%d) excede el aforo máximo (%d)",
 		mensaje->familia, mensaje->num_personas, capacidad_maxima);
 		solicitudes_rechazadas++;
 	}
 	// *VALIDACIÓN 3: Hora ya pasó*
-	else if (mensaje->hora_solicitada < hora_actual) {
-		snprintf(respuesta, sizeof(respuesta),
+	else if (mensaje->hora_solicitada < hora_decision) {
+		snprintf(respuesta, tam_respuesta,
 		"RESERVA NEGADA POR EXTEMPORÁNEA: Familia %s - Hora solicitada (%d) ya pasó (hora actual: %d)",
-		mensaje->familia, mensaje->hora_solicitada, hora_actual);
+		mensaje->familia, mensaje->hora_solicitada, hora_decision);
 		solicitudes_rechazadas++;
 
 		// Buscar alternativa para reserva extemporánea
-		int hora_alternativa = encontrar_hora_alternativa(mensaje->hora_solicitada, mensaje->num_personas);
+		int hora_alternativa = encontrar_hora_alternativa(cfg, hora_decision, mensaje->hora_solicitada, mensaje->num_personas);
 		if (hora_alternativa != -1) {
-			snprintf(respuesta, sizeof(respuesta),
+			snprintf(respuesta, tam_respuesta,
 			"RESERVA REPROGRAMADA: Familia %s - Aceptada para hora %d (solicitó %d) con %d personas",
 			mensaje->familia, hora_alternativa, mensaje->hora_solicitada, mensaje->num_personas);
 			agregar_reserva(mensaje->familia, mensaje->nombre_agente, hora_alternativa, mensaje->num_personas, 2);
 			solicitudes_reprogramadas++;
+			decision = 2;
+			*hora_asignada = hora_alternativa;
 		}
 	}
-	// *VERIFICAR DISPONIBILIDAD PARA HORA SOLICITADA*
+	// *VERIFICAR DISPONIBILIDAD PARA HORA SOLICITADA (O LA PRIMERA ALTERNATIVA)*
 	else {
-		int disponible = verificar_disponibilidad(mensaje->hora_solicitada, mensaje->num_personas);
+		int hora_reservada = reservar_ventana(cfg, hora_decision, mensaje->hora_solicitada, mensaje->num_personas);
 
-		if (disponible) {
+		if (hora_reservada == mensaje->hora_solicitada) {
 			// *RESERVA ACEPTADA EN HORA SOLICITADA*
-			snprintf(respuesta, sizeof(respuesta),
+			snprintf(respuesta, tam_respuesta,
 			"RESERVA OK: Familia %s - Aceptada para hora %d con %d personas",
 			mensaje->familia, mensaje->hora_solicitada, mensaje->num_personas);
 
 			agregar_reserva(mensaje->familia, mensaje->nombre_agente, mensaje->hora_solicitada, mensaje->num_personas, 1);
 			solicitudes_aceptadas++;
+			decision = 1;
+			*hora_asignada = mensaje->hora_solicitada;
 		} else {
-			// *BUSCAR HORA ALTERNATIVA*
-			int hora_alternativa = encontrar_hora_alternativa(mensaje->hora_solicitada, mensaje->num_personas);
+			// *HORA ALTERNATIVA*
+			int hora_alternativa = hora_reservada;
 
 			if (hora_alternativa != -1) {
 				// *RESERVA REPROGRAMADA*
-				snprintf(respuesta, sizeof(respuesta),
+				snprintf(respuesta, tam_respuesta,
 				"RESERVA REPROGRAMADA: Familia %s - Aceptada para hora %d (solicitó %d) con %d personas",
 				mensaje->familia, hora_alternativa, mensaje->hora_solicitada, mensaje->num_personas);
 
 				agregar_reserva(mensaje->familia, mensaje->nombre_agente, hora_alternativa, mensaje->num_personas, 2);
 				solicitudes_reprogramadas++;
+				decision = 2;
+				*hora_asignada = hora_alternativa;
 			} else {
 				// *RESERVA NEGADA SIN ALTERNATIVAS*
-				snprintf(respuesta, sizeof(respuesta), "RESERVA NEGADA: Familia %s - No hay cupo disponible para ningún horario", mensaje->familia);
+				snprintf(respuesta, tam_respuesta, "RESERVA NEGADA: Familia %s - No hay cupo disponible para ningún horario", mensaje->familia);
 				solicitudes_rechazadas++;
 			}
 		}
 	}
 
+	return decision;
+}
+
+// Procesar solicitud de reserva
+void procesar_solicitud_reserva(MensajeAgente *mensaje) {
+	// El coordinador solo entrega la solicitud; la decide la partición dueña de la hora
+	if (num_particiones > 0 && particion_propia < 0) {
+		enrutar_solicitud(mensaje);
+		return;
+	}
+
+	printf("SOLICITUD RECIBIDA: Agente %s - Familia %s, Hora %d, Personas %d\n", mensaje->nombre_agente, mensaje->familia, mensaje->hora_solicitada, mensaje->num_personas);
+
+	char respuesta[BUFFER_SIZE];
+	int hora_asignada;
+	int hora_decision = hora_actual;
+	const Configuracion *cfg = leer_configuracion();
+	int decision = decidir_reserva(cfg, hora_decision, mensaje, respuesta, sizeof(respuesta), &hora_asignada);
+
+	registrar_traza(mensaje, cfg->version, hora_decision, decision, hora_asignada);
+
 	// Enviar respuesta al agente
 	responder_agente(mensaje->pipe_respuesta, respuesta);
 	printf("RESPUESTA ENVIADA: %s\n", respuesta);
 }
 
-// Verificar disponibilidad para 2 horas consecutivas
-int verificar_disponibilidad(int hora_inicio, int num_personas) {
+// Verificar si hay cupo para las 2 horas desde hora (requiere mutex_horas)
+int ventana_disponible(const Configuracion *cfg, int hora, int num_personas) {
+	return buscar_ventana(cfg->capacidad_hora, estado_horas.capacidad_actual, hora, hora, HORAS_POR_RESERVA, cfg->hora_fin, num_personas) != -1;
+}
+
+// Reservar en la hora solicitada o, si no cabe, en la primera alternativa.
+// Devuelve la hora reservada o -1 si no hay cupo en ningún horario
+int reservar_ventana(const Configuracion *cfg, int hora_decision, int hora_solicitada, int num_personas) {
+	int hora_fin = cfg->hora_fin;
+	unsigned int indice = ((unsigned int)hora_solicitada * 31u + (unsigned int)num_personas) & (TAM_CACHE_ADMISION - 1);
+	int h = -1;
+
+	if (particion_propia >= 0) {
+		// Sin caché: las retenciones de otras particiones suben y bajan la ocupación,
+		// así que una respuesta negativa puede dejar de serlo
+		return reservar_en_particiones(cfg, hora_decision, hora_solicitada, num_personas);
+	}
+
 	pthread_mutex_lock(&mutex_horas);
 
-	// Verificar que hay cupo para las 2 horas
-	for (int h = hora_inicio; h < hora_inicio + 2 && h <= hora_fin; h++) {
-		if (estado_horas[h].capacidad_actual + num_personas > estado_horas[h].capacidad_maxima) {
-			pthread_mutex_unlock(&mutex_horas);
-			return 0; // No hay cupo
-		}
+	EntradaCacheAdmision *entrada = &cache_admision[indice];
+	int acierto = entrada->version == cfg->version && entrada->hora_solicitada == hora_solicitada && entrada->num_personas == num_personas;
+
+	if (acierto && entrada->hora_ventana == -1) {
+		// Sin cupo para este tamaño: sigue sin haberlo hasta que cambie la capacidad
+		aciertos_cache++;
+		pthread_mutex_unlock(&mutex_horas);
+		return -1;
 	}
 
-	// Reservar el cupo
-	for (int h = hora_inicio; h < hora_inicio + 2 && h <= hora_fin; h++) {
-		estado_horas[h].capacidad_actual += num_personas;
-		if (h == hora_inicio) {
-			estado_horas[h].personas_entrando += num_personas;
-		}
-		if (h == hora_inicio + 1) {
-			estado_horas[h].personas_saliendo += num_personas;
+	if (acierto && entrada->hora_ventana >= hora_decision && ventana_disponible(cfg, entrada->hora_ventana, num_personas)) {
+		// Las ventanas anteriores a la guardada ya estaban llenas y solo pueden haberse llenado más
+		aciertos_cache++;
+		h = entrada->hora_ventana;
+	} else {
+		fallos_cache++;
+
+		// Verificar que hay cupo para las 2 horas solicitadas
+		if (ventana_disponible(cfg, hora_solicitada, num_personas)) {
+			h = hora_solicitada;
+		} else {
+			// Buscar cualquier bloque de 2 horas disponible
+			h = buscar_ventana(cfg->capacidad_hora, estado_horas.capacidad_actual, hora_decision, hora_fin - 1, HORAS_POR_RESERVA, hora_fin, num_personas);
 		}
+
+		entrada->hora_solicitada = hora_solicitada;
+		entrada->num_personas = num_personas;
+		entrada->hora_ventana = h;
+		entrada->version = cfg->version;
+	}
+
+	if (h != -1) {
+		// Reservar el cupo
+		ocupar_ventana(h, hora_fin, num_personas);
 	}
 
 	pthread_mutex_unlock(&mutex_horas);
-	return 1; // Cupo disponible
+	return h;
 }
 
 // Encontrar hora alternativa disponible
-int encontrar_hora_alternativa(int hora_solicitada, int num_personas) {
+int encontrar_hora_alternativa(const Configuracion *cfg, int hora_decision, int hora_solicitada, int num_personas) {
+	int hora_fin = cfg->hora_fin;
+
+	if (particion_propia >= 0) {
+		return reservar_en_particiones(cfg, hora_decision, -1, num_personas);
+	}
+
 	pthread_mutex_lock(&mutex_horas);
 
 	// Buscar cualquier bloque de 2 horas disponible
-	for (int h = hora_actual; h <= hora_fin - 1; h++) {
-		int disponible = 1;
+	int h = buscar_ventana(cfg->capacidad_hora, estado_horas.capacidad_actual, hora_decision, hora_fin - 1, HORAS_POR_RESERVA, hora_fin, num_personas);
 
-		// Verificar las 2 horas
-		for (int h2 = h; h2 < h + 2 && h2 <= hora_fin; h2++) {
-			if (estado_horas[h2].capacidad_actual + num_personas > estado_horas[h2].capacidad_maxima) {
-				disponible = 0;
-				break;
-			}
-		}
+	if (h != -1) {
+		// Reservar el cupo
+		ocupar_ventana(h, hora_fin, num_personas);
+	}
 
-		if (disponible) {
-			// Reservar el cupo
-			for (int h2 = h; h2 < h + 2 && h2 <= hora_fin; h2++) {
-				estado_horas[h2].capacidad_actual += num_personas;
-				if (h2 == h) {
-				estado_horas[h2].personas_entrando += num_personas;
-				}
-				if (h2 == h + 1) {
-					estado_horas[h2].personas_saliendo += num_personas;
-				}
-			}
+	pthread_mutex_unlock(&mutex_horas);
+	return h; // -1 si no hay alternativas
+}
 
-			pthread_mutex_unlock(&mutex_horas);
-			return h;
+// Sumar una reserva a las horas de su ventana (requiere mutex_horas)
+void ocupar_ventana(int hora, int hora_fin, int num_personas) {
+	for (int h = hora; h < hora + HORAS_POR_RESERVA && h <= hora_fin; h++) {
+		estado_horas.capacidad_actual[h] += num_personas;
+		if (h == hora) {
+			estado_horas.personas_entrando[h] += num_personas;
+		}
+		if (h == hora + 1) {
+			estado_horas.personas_saliendo[h] += num_personas;
 		}
 	}
+}
 
-	pthread_mutex_unlock(&mutex_horas);
-	return -1; // No hay alternativas
+/* Máscara de cupo, versión escalar */
+static void mascara_cupo_escalar(const int *capacidad, const int *ocupado, int n, int num_personas, uint64_t *mascara) {
+	for (int i = 0; i < n; i++) {
+		if (capacidad[i] - ocupado[i] >= num_personas) {
+			mascara[i >> 6] |= 1ULL << (i & 63);
+		}
+	}
 }
 
-// Responder al agente
-void responder_agente(const char *pipe_respuesta, const char *mensaje) {
-	int fd = open(pipe_respuesta, O_WRONLY);
-	if (fd == -1) {
-		perror("Error abriendo pipe de respuesta del agente");
-		return;
+#if defined(__x86_64__)
+/* Máscara de cupo con SSE2 (4 franjas por instrucción) */
+static void mascara_cupo_sse2(const int *capacidad, const int *ocupado, int n, int num_personas, uint64_t *mascara) {
+	__m128i umbral = _mm_set1_epi32(num_personas - 1);
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i libre = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(capacidad + i)), _mm_loadu_si128((const __m128i *)(ocupado + i)));
+		uint64_t bits = (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(libre, umbral)));
+		mascara[i >> 6] |= bits << (i & 63);
 	}
 
-	write(fd, mensaje, strlen(mensaje) + 1);
-	close(fd);
+	for (; i < n; i++) {
+		if (capacidad[i] - ocupado[i] >= num_personas) {
+			mascara[i >> 6] |= 1ULL << (i & 63);
+		}
+	}
 }
 
-// Avanzar hora de simulación
-void avanzar_hora_simulacion() {
-	hora_actual++;
-
-	printf("\n=====| HORA ACTUAL: %d |=====\n", hora_actual);
-	printf("\nPersonas entrando: %d\n", estado_horas[hora_actual].personas_entrando);
-	printf("Personas saliendo: %d\n", estado_horas[hora_actual].personas_saliendo);
-	printf("Personas presentes: %d\n", estado_horas[hora_actual].capacidad_actual);
+/* Máscara de cupo con AVX2 (8 franjas por instrucción) */
+__attribute__((target("avx2")))
+static void mascara_cupo_avx2(const int *capacidad, const int *ocupado, int n, int num_personas, uint64_t *mascara) {
+	__m256i umbral = _mm256_set1_epi32(num_personas - 1);
+	int i = 0;
 
-	// Resetear contadores de movimiento para la próxima hora
-	if (hora_actual + 1 < 24) {
-		estado_horas[hora_actual + 1].personas_entrando = 0;
-		estado_horas[hora_actual + 1].personas_saliendo = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i libre = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(capacidad + i)), _mm256_loadu_si256((const __m256i *)(ocupado + i)));
+		uint64_t bits = (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(libre, umbral)));
+		mascara[i >> 6] |= bits << (i & 63);
 	}
 
-	// Verificar fin de simulación
-	if (hora_actual >= hora_fin) {
-		printf("=====| FINAL DE LA SIMULACIÓN |=====\n");
+	for (; i < n; i++) {
+		if (capacidad[i] - ocupado[i] >= num_personas) {
+			mascara[i >> 6] |= 1ULL << (i & 63);
+		}
+	}
+}
+#endif
+
+/* Elegir el kernel más ancho que soporte la CPU */
+void seleccionar_kernel_cupo() {
+	mascara_cupo = mascara_cupo_escalar;
+#if defined(__x86_64__)
+	mascara_cupo = mascara_cupo_sse2;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		mascara_cupo = mascara_cupo_avx2;
 	}
+#endif
 }
 
-/* Agregar reserva a la lista */
-void agregar_reserva(const char *familia, const char *agente, int hora_entrada, int num_personas, int estado) {
-	pthread_mutex_lock(&mutex_reservas);
+/* Primera franja h en [desde, hasta] tal que las franjas h..h+ancho-1 (recortadas en limite)
+ * tienen cupo libre >= num_personas. Devuelve -1 si no hay ninguna. ancho debe ser <= 64 */
+int buscar_ventana(const int *capacidad, const int *ocupado, int desde, int hasta, int ancho, int limite, int num_personas) {
+	if (hasta < desde || num_personas <= 0) {
+		return hasta < desde ? -1 : buscar_ventana_escalar(capacidad, ocupado, desde, hasta, ancho, limite, num_personas);
+	}
 
-	Reserva *nueva_reserva = malloc(sizeof(Reserva));
-	strncpy(nueva_reserva->familia, familia, sizeof(nueva_reserva->familia));
-	strncpy(nueva_reserva->agente, agente, sizeof(nueva_reserva->agente));
-	nueva_reserva->hora_entrada = hora_entrada;
-	nueva_reserva->num_personas = num_personas;
-	nueva_reserva->estado = estado;
-	nueva_reserva->siguiente = lista_reservas;
-	lista_reservas = nueva_reserva;
+	int total = hasta - desde + ancho;
+	int evaluadas = limite - desde + 1;
+	if (evaluadas > total) evaluadas = total;
+	if (evaluadas < 0) evaluadas = 0;
 
-	pthread_mutex_unlock(&mutex_reservas);
-}
+	// Una palabra extra en cero para leer la siguiente al desplazar
+	int palabras = (total + 63) / 64;
+	uint64_t mascara[palabras + 1];
+	memset(mascara, 0, sizeof(mascara));
 
-/* Generar reporte final */
-void generar_reporte_final() {
-	printf("\n=====| REPORTE FINAL DEL SISTEMA DE RESERVAS |=====\n");
+	mascara_cupo(capacidad + desde, ocupado + desde, evaluadas, num_personas, mascara);
 
-	// Calcular horas pico y horas bajas
-	int max_personas = 0;
-	int min_personas = capacidad_maxima;
-	int horas_pico[24], num_horas_pico = 0;
-	int horas_bajas[24], num_horas_bajas = 0;
+	// Las franjas después de limite no restringen la ventana
+	for (int i = evaluadas; i < total; i++) {
+		mascara[i >> 6] |= 1ULL << (i & 63);
+	}
 
-	for (int i = hora_inicio; i <= hora_fin; i++) {
-		if (estado_horas[i].capacidad_actual > max_personas) {
-			max_personas = estado_horas[i].capacidad_actual;
-			num_horas_pico = 0;
-			horas_pico[num_horas_pico++] = i;
-		} else if (estado_horas[i].capacidad_actual == max_personas) {
-			horas_pico[num_horas_pico++] = i;
+	// Un bit queda activo si él y sus ancho-1 siguientes lo están
+	int inicios = hasta - desde + 1;
+	for (int j = 0; j < palabras && j * 64 < inicios; j++) {
+		uint64_t ventanas = mascara[j];
+		for (int k = 1; k < ancho; k++) {
+			ventanas &= (mascara[j] >> k) | (mascara[j + 1] << (64 - k));
 		}
 
-		if (estado_horas[i].capacidad_actual < min_personas) {
-			min_personas = estado_horas[i].capacidad_actual;
-			num_horas_bajas = 0;
-			horas_bajas[num_horas_bajas++] = i;
-		} else if (estado_horas[i].capacidad_actual == min_personas) {
-			horas_bajas[num_horas_bajas++] = i;
+		int restantes = inicios - j * 64;
+		if (restantes < 64) {
+			ventanas &= (1ULL << restantes) - 1;
 		}
-	}
-
-	/* Imprimir estadísticas */
-	printf("\n=====| ESTADÍSTICAS DE SOLICITUDES |=====\n\n");
-	printf("Solicitudes aceptadas en hora solicitada: %d\n", solicitudes_aceptadas);
-	printf("Solicitudes reprogramadas: %d\n", solicitudes_reprogramadas);
-	printf("Solicitudes rechazadas: %d\n", solicitudes_rechazadas);
-	printf("Total de solicitudes procesadas: %d\n", solicitudes_aceptadas + solicitudes_reprogramadas + solicitudes_rechazadas);
 
-	printf("\n=====| ANÁLISIS DE OCUPACIÓN |=====\n\n");
-	printf("Horas pico (%d personas): ", max_personas);
-	for (int i = 0; i < num_horas_pico; i++) {
-		printf("%d ", horas_pico[i]);
+		if (ventanas != 0) {
+			return desde + j * 64 + __builtin_ctzll(ventanas);
+		}
 	}
-	printf("\n");
 
-	printf("Horas de menor afluencia (%d personas): ", min_personas);
-	for (int i = 0; i < num_horas_bajas; i++) {
-		printf("%d ", horas_bajas[i]);
-	}
-	printf("\n");
+	return -1;
+}
 
-	printf("\n=====| RESUMEN POR HORA |=====\n\n");
-	for (int i = hora_inicio; i <= hora_fin; i++) {
-		printf("Hora %d: %d personas (de %d máximo)\n", i, estado_horas[i].capacidad_actual, capacidad_maxima);
-	}
+/* Búsqueda de referencia con el recorrido franja por franja original */
+int buscar_ventana_escalar(const int *capacidad, const int *ocupado, int desde, int hasta, int ancho, int limite, int num_personas) {
+	for (int h = desde; h <= hasta; h++) {
+		int disponible = 1;
+
+		for (int h2 = h; h2 < h + ancho && h2 <= limite; h2++) {
+			if (ocupado[h2] + num_personas > capacidad[h2]) {
+				disponible = 0;
+				break;
+			}
+		}
+
+		if (disponible) {
+			return h;
+		}
+	}
+
+	return -1;
+}
+
+/* Microbenchmark: kernel vectorial contra el recorrido escalar sobre muchas franjas */
+int medir_busqueda_cupo(int iteraciones) {
+	int tamanos[] = {24, 1024, 8192};
+	int errores = 0;
+
+	seleccionar_kernel_cupo();
+	printf("=====| MEDICIÓN DE BÚSQUEDA DE CUPO |=====\n");
+#if defined(__x86_64__)
+	printf("Kernel: %s\n", mascara_cupo == mascara_cupo_avx2 ? "AVX2" : "SSE2");
+#else
+	printf("Kernel: escalar\n");
+#endif
+
+	for (size_t t = 0; t < sizeof(tamanos) / sizeof(tamanos[0]); t++) {
+		int n = tamanos[t];
+		int *capacidad = malloc(n * sizeof(int));
+		int *ocupado = malloc(n * sizeof(int));
+		if (capacidad == NULL || ocupado == NULL) {
+			free(capacidad);
+			free(ocupado);
+			perror("Error reservando franjas");
+			return 1;
+		}
+
+		// Temporada casi llena: pocas franjas con cupo, la única ventana al final
+		srand(n);
+		for (int i = 0; i < n; i++) {
+			capacidad[i] = 100;
+			ocupado[i] = 90 + rand() % 11;
+		}
+		ocupado[n - 2] = 0;
+		ocupado[n - 1] = 0;
+
+		struct timespec inicio, fin;
+		volatile int resultado_escalar = 0, resultado_kernel = 0;
+
+		clock_gettime(CLOCK_MONOTONIC, &inicio);
+		for (int k = 0; k < iteraciones; k++) {
+			resultado_escalar = buscar_ventana_escalar(capacidad, ocupado, 0, n - 2, HORAS_POR_RESERVA, n - 1, 20 + k % 8);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &fin);
+		double ns_escalar = ((fin.tv_sec - inicio.tv_sec) * 1e9 + (fin.tv_nsec - inicio.tv_nsec)) / iteraciones;
+
+		clock_gettime(CLOCK_MONOTONIC, &inicio);
+		for (int k = 0; k < iteraciones; k++) {
+			resultado_kernel = buscar_ventana(capacidad, ocupado, 0, n - 2, HORAS_POR_RESERVA, n - 1, 20 + k % 8);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &fin);
+		double ns_kernel = ((fin.tv_sec - inicio.tv_sec) * 1e9 + (fin.tv_nsec - inicio.tv_nsec)) / iteraciones;
+
+		// Comprobar que ambos coinciden en todos los umbrales y rangos
+		for (int personas = 1; personas <= 101; personas += 5) {
+			for (int desde = 0; desde < n - 1 && desde < 80; desde += 7) {
+				if (buscar_ventana(capacidad, ocupado, desde, n - 2, HORAS_POR_RESERVA, n - 1, personas) !=
+				    buscar_ventana_escalar(capacidad, ocupado, desde, n - 2, HORAS_POR_RESERVA, n - 1, personas)) {
+					errores++;
+				}
+			}
+		}
+
+		printf("Franjas %5d: escalar %10.1f ns, kernel %10.1f ns (x%.1f), resultado %d/%d\n",
+		n, ns_escalar, ns_kernel, ns_kernel > 0 ? ns_escalar / ns_kernel : 0.0, resultado_escalar, resultado_kernel);
+
+		free(capacidad);
+		free(ocupado);
+	}
+
+	printf("Diferencias entre kernel y recorrido escalar: %d\n", errores);
+	return errores > 0 ? 2 : 0;
+}
+
+/* Crear los pipes y los procesos de partición. Las horas [hora_inicio, hora_fin] se
+ * reparten en rangos contiguos; la primera y la última también cubren los extremos
+ * del día para que una recarga que extienda el horario siga teniendo dueña.
+ * Cada proceso abre primero sus extremos de lectura con O_RDWR (no se bloquea) y
+ * después los de escritura, así ninguna apertura espera a otra en ciclo */
+int iniciar_particiones(int cantidad) {
+	const Configuracion *cfg = leer_configuracion();
+	int horas = cfg->hora_fin - hora_inicio + 1;
+
+	if (cantidad > horas) {
+		cantidad = horas;
+	}
+
+	atendidas = mmap(NULL, MAX_PARTICIONES * sizeof(unsigned long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (atendidas == MAP_FAILED) {
+		atendidas = NULL;
+		perror("Error creando memoria compartida de particiones");
+		return -1;
+	}
+
+	// Todos los pipes existen antes del primer fork
+	num_particiones = cantidad;
+	snprintf(pipes_respuestas[cantidad], sizeof(pipes_respuestas[cantidad]), "%s_coordinador_resp", pipe_controlador);
+	fd_respuestas[cantidad] = -1;
+
+	for (int p = 0; p < cantidad; p++) {
+		Particion *particion = &particiones[p];
+		particion->pid = -1;
+		particion->activa = 1;
+		particion->fd_solicitudes = -1;
+		particion->fd_servicio = -1;
+		particion->desde = p == 0 ? 0 : hora_inicio + horas * p / cantidad;
+		particion->hasta = p == cantidad - 1 ? HORAS_DIA - 1 : hora_inicio + horas * (p + 1) / cantidad - 1;
+		snprintf(particion->pipe_solicitudes, sizeof(particion->pipe_solicitudes), "%s_particion_%d_sol", pipe_controlador, p);
+		snprintf(particion->pipe_servicio, sizeof(particion->pipe_servicio), "%s_particion_%d_serv", pipe_controlador, p);
+		snprintf(pipes_respuestas[p], sizeof(pipes_respuestas[p]), "%s_particion_%d_resp", pipe_controlador, p);
+		fd_respuestas[p] = -1;
+	}
+
+	for (int p = 0; p <= cantidad; p++) {
+		if ((p < cantidad && mkfifo(particiones[p].pipe_solicitudes, 0666) == -1 && errno != EEXIST) ||
+		    (p < cantidad && mkfifo(particiones[p].pipe_servicio, 0666) == -1 && errno != EEXIST) ||
+		    (mkfifo(pipes_respuestas[p], 0666) == -1 && errno != EEXIST)) {
+			perror("Error creando pipes de partición");
+			return -1;
+		}
+	}
+
+	// Evitar que los hijos hereden y repitan salida pendiente
+	fflush(stdout);
+
+	for (int p = 0; p < cantidad; p++) {
+		particiones[p].pid = fork();
+		if (particiones[p].pid == -1) {
+			perror("Error creando proceso de partición");
+			return -1;
+		}
+
+		if (particiones[p].pid == 0) {
+			ejecutar_particion(p);
+			_exit(0);
+		}
+	}
+
+	fd_mis_respuestas = open(pipes_respuestas[cantidad], O_RDWR);
+	if (fd_mis_respuestas == -1) {
+		perror("Error abriendo pipe de respuestas del coordinador");
+		return -1;
+	}
+
+	for (int p = 0; p < cantidad; p++) {
+		Particion *particion = &particiones[p];
+		particion->fd_solicitudes = abrir_pipe_escritura(particion->pipe_solicitudes);
+		particion->fd_servicio = abrir_pipe_escritura(particion->pipe_servicio);
+		if (particion->fd_solicitudes == -1 || particion->fd_servicio == -1) {
+			fprintf(stderr, "Error: La partición %d no abrió sus pipes\n", p);
+			return -1;
+		}
+
+		printf("Partición %d (pid %d): horas %d-%d\n", p, (int)particion->pid, particion->desde, particion->hasta);
+	}
+
+	return 0;
+}
+
+/* Abrir un pipe para escribir esperando a lo sumo ESPERA_PARTICION_MS a que aparezca
+ * su lector; un proceso que murió al arrancar no deja bloqueado a quien lo espera */
+int abrir_pipe_escritura(const char *ruta) {
+	for (int espera = 0; espera < ESPERA_PARTICION_MS; espera += 10) {
+		int fd = open(ruta, O_WRONLY | O_NONBLOCK);
+		if (fd != -1) {
+			// Las escrituras sí esperan cuando el pipe está lleno
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+			return fd;
+		}
+		if (errno != ENXIO) {
+			break;
+		}
+		usleep(10000);
+	}
+
+	return -1;
+}
+
+/* Cuerpo del proceso de partición: el hilo de servicio atiende las peticiones de las
+ * demás sobre sus horas y este hilo (admisión) decide las solicitudes que le entrega
+ * el coordinador. Termina cuando el coordinador cierra el pipe de solicitudes */
+void ejecutar_particion(int indice) {
+	particion_propia = indice;
+
+	// pkill por nombre también alcanza a los hijos: Ctrl-C y SIGHUP son del coordinador.
+	// Un par que desaparece se detecta con EPIPE
+	signal(SIGINT, SIG_IGN);
+	signal(SIGHUP, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGTERM, SIG_DFL);
+	sigset_t senales;
+	sigemptyset(&senales);
+	sigaddset(&senales, SIGTERM);
+	pthread_sigmask(SIG_UNBLOCK, &senales, NULL);
+
+	// Comparte la salida con el coordinador y termina con _exit
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	int fd_servicio = open(particiones[indice].pipe_servicio, O_RDWR);
+	fd_mis_respuestas = open(pipes_respuestas[indice], O_RDWR);
+	int fd_solicitudes = open(particiones[indice].pipe_solicitudes, O_RDONLY);
+	if (fd_servicio == -1 || fd_mis_respuestas == -1 || fd_solicitudes == -1) {
+		perror("Error abriendo pipes en la partición");
+		return;
+	}
+
+	for (int q = 0; q < num_particiones; q++) {
+		if (q != indice && (particiones[q].fd_servicio = abrir_pipe_escritura(particiones[q].pipe_servicio)) == -1) {
+			particiones[q].activa = 0;
+		}
+	}
+	for (int origen = 0; origen <= num_particiones; origen++) {
+		if (origen != indice) {
+			fd_respuestas[origen] = abrir_pipe_escritura(pipes_respuestas[origen]);
+		}
+	}
+
+	inicializar_horas();
+
+	pthread_t hilo_servicio;
+	if (pthread_create(&hilo_servicio, NULL, hilo_servicio_particion, &fd_servicio) != 0) {
+		perror("Error creando hilo de servicio de la partición");
+		return;
+	}
+
+	int desde = particiones[indice].desde;
+	int hasta = particiones[indice].hasta;
+
+	SolicitudParticion solicitud;
+	while (read(fd_solicitudes, &solicitud, sizeof(solicitud)) == sizeof(solicitud)) {
+		switch (solicitud.tipo) {
+		case 1: // RESERVA
+			procesar_solicitud_reserva(&solicitud.mensaje);
+			__atomic_add_fetch(&atendidas[indice], 1, __ATOMIC_RELEASE);
+			break;
+		case 2: { // AVANZAR: resetear contadores de movimiento de la próxima hora
+			int siguiente = solicitud.hora_actual + 1;
+			pthread_mutex_lock(&mutex_horas);
+			hora_actual = solicitud.hora_actual;
+			if (siguiente >= desde && siguiente <= hasta && siguiente < HORAS_DIA) {
+				estado_horas.personas_entrando[siguiente] = 0;
+				estado_horas.personas_saliendo[siguiente] = 0;
+			}
+			pthread_mutex_unlock(&mutex_horas);
+			break;
+		}
+		case 3: { // CONFIGURAR
+			Configuracion *nueva = malloc(sizeof(Configuracion));
+			if (nueva == NULL) break;
+			*nueva = *leer_configuracion();
+			nueva->hora_fin = solicitud.hora_fin;
+			memcpy(nueva->capacidad_hora, solicitud.capacidad, sizeof(nueva->capacidad_hora));
+			publicar_configuracion(nueva);
+			break;
+		}
+		}
+	}
+
+	close(fd_solicitudes);
+}
+
+/* Hilo de servicio de una partición. Nunca consulta a otra partición, así que un hilo
+ * de admisión que espera su respuesta no puede quedar en un ciclo de esperas */
+void *hilo_servicio_particion(void *arg) {
+	int fd_servicio = *(int *)arg;
+
+	MensajeParticion peticion;
+	while (read(fd_servicio, &peticion, sizeof(peticion)) == sizeof(peticion)) {
+		if (peticion.origen < 0 || peticion.origen > num_particiones || fd_respuestas[peticion.origen] == -1) {
+			continue;
+		}
+
+		RespuestaParticion respuesta;
+		pthread_mutex_lock(&mutex_horas);
+		atender_peticion_particion(&peticion, &respuesta);
+		pthread_mutex_unlock(&mutex_horas);
+
+		// Si quien preguntó ya terminó, la escritura falla con EPIPE y se descarta
+		write(fd_respuestas[peticion.origen], &respuesta, sizeof(respuesta));
+	}
+
+	return NULL;
+}
+
+/* Deshacer la retención de un origen y, si se confirma, ocupar la ventana (requiere mutex_horas) */
+void liberar_retencion(int origen, int confirmar) {
+	const MensajeParticion *retencion = &retenciones[origen];
+	int primera = retencion->hora > particiones[particion_propia].desde ? retencion->hora : particiones[particion_propia].desde;
+	int ultima = retencion->hora + HORAS_POR_RESERVA - 1;
+	if (ultima > retencion->hora_fin) ultima = retencion->hora_fin;
+	if (ultima > particiones[particion_propia].hasta) ultima = particiones[particion_propia].hasta;
+
+	for (int h = primera; h <= ultima; h++) {
+		estado_horas.capacidad_actual[h] -= retencion->num_personas;
+	}
+	if (confirmar) {
+		// Las horas ajenas que toque ocupar_ventana nunca se consultan aquí
+		ocupar_ventana(retencion->hora, retencion->hora_fin, retencion->num_personas);
+	}
+
+	retencion_activa[origen] = 0;
+}
+
+/* Aplicar una petición sobre las horas propias (requiere mutex_horas). La usan el hilo
+ * de servicio y, sin pasar por los pipes, el hilo de admisión de la misma partición */
+void atender_peticion_particion(const MensajeParticion *peticion, RespuestaParticion *respuesta) {
+	int desde = particiones[particion_propia].desde;
+	int hasta = particiones[particion_propia].hasta;
+	int origen = peticion->origen;
+
+	memset(respuesta, 0, sizeof(*respuesta));
+	respuesta->secuencia = peticion->secuencia;
+
+	// Horas propias dentro de la ventana de la petición
+	int primera = peticion->hora > desde ? peticion->hora : desde;
+	int ultima = peticion->hora + HORAS_POR_RESERVA - 1;
+	if (ultima > peticion->hora_fin) ultima = peticion->hora_fin;
+	if (ultima > hasta) ultima = hasta;
+
+	switch (peticion->tipo) {
+	case 1: { // CUPO: horas propias desde peticion->hora hasta hora_fin
+		int fin = peticion->hora_fin < hasta ? peticion->hora_fin : hasta;
+		if (fin >= primera) {
+			uint64_t mascara[2] = {0, 0};
+			mascara_cupo(peticion->capacidad + primera, estado_horas.capacidad_actual + primera, fin - primera + 1, peticion->num_personas, mascara);
+			respuesta->mascara = (uint32_t)(mascara[0] << primera);
+		}
+		respuesta->ok = 1;
+		break;
+	}
+	case 2: // RESERVAR: la ventana completa es propia
+	case 3: // PREPARAR: retener la parte propia de la ventana
+		if (peticion->tipo == 3 && retencion_activa[origen]) {
+			// Cada origen tiene una transacción a la vez: la anterior quedó abandonada
+			liberar_retencion(origen, 0);
+		}
+		respuesta->ok = 1;
+		for (int h = primera; h <= ultima && respuesta->ok; h++) {
+			if (estado_horas.capacidad_actual[h] + peticion->num_personas > peticion->capacidad[h]) {
+				respuesta->ok = 0;
+			}
+		}
+		if (respuesta->ok && peticion->tipo == 2) {
+			ocupar_ventana(peticion->hora, peticion->hora_fin, peticion->num_personas);
+		} else if (respuesta->ok) {
+			for (int h = primera; h <= ultima; h++) {
+				estado_horas.capacidad_actual[h] += peticion->num_personas;
+			}
+			retenciones[origen] = *peticion;
+			retencion_activa[origen] = 1;
+		}
+		break;
+	case 4: // CONFIRMAR
+	case 5: // ABORTAR
+		respuesta->ok = retencion_activa[origen];
+		if (retencion_activa[origen]) {
+			liberar_retencion(origen, peticion->tipo == 4);
+		}
+		break;
+	case 6: // ESTADO
+		memcpy(respuesta->capacidad_actual, estado_horas.capacidad_actual, sizeof(respuesta->capacidad_actual));
+		memcpy(respuesta->personas_entrando, estado_horas.personas_entrando, sizeof(respuesta->personas_entrando));
+		memcpy(respuesta->personas_saliendo, estado_horas.personas_saliendo, sizeof(respuesta->personas_saliendo));
+		respuesta->aceptadas = solicitudes_aceptadas;
+		respuesta->reprogramadas = solicitudes_reprogramadas;
+		respuesta->rechazadas = solicitudes_rechazadas;
+		respuesta->ok = 1;
+		break;
+	}
+}
+
+/* Cerrar los pipes de solicitudes (las particiones terminan al leer EOF), esperar a los
+ * procesos y borrar los pipes. Una partición que no termina a tiempo recibe SIGTERM */
+void detener_particiones() {
+	for (int p = 0; p < num_particiones; p++) {
+		if (particiones[p].fd_solicitudes != -1) close(particiones[p].fd_solicitudes);
+		if (particiones[p].fd_servicio != -1) close(particiones[p].fd_servicio);
+	}
+
+	for (int p = 0; p < num_particiones; p++) {
+		if (particiones[p].pid > 0) {
+			int espera = 0;
+			while (waitpid(particiones[p].pid, NULL, WNOHANG) == 0) {
+				if (espera >= ESPERA_PARTICION_MS) {
+					kill(particiones[p].pid, SIGTERM);
+					waitpid(particiones[p].pid, NULL, 0);
+					break;
+				}
+				usleep(10000);
+				espera += 10;
+			}
+		}
+		unlink(particiones[p].pipe_solicitudes);
+		unlink(particiones[p].pipe_servicio);
+		unlink(pipes_respuestas[p]);
+	}
+
+	if (num_particiones > 0) {
+		unlink(pipes_respuestas[num_particiones]);
+	}
+	if (fd_mis_respuestas != -1) {
+		close(fd_mis_respuestas);
+		fd_mis_respuestas = -1;
+	}
+	if (atendidas != NULL) {
+		munmap(atendidas, MAX_PARTICIONES * sizeof(unsigned long));
+		atendidas = NULL;
+	}
+
+	num_particiones = 0;
+}
+
+/* Índice de la partición dueña de una hora */
+int particion_de_hora(int hora) {
+	for (int p = 0; p < num_particiones; p++) {
+		if (hora >= particiones[p].desde && hora <= particiones[p].hasta) {
+			return p;
+		}
+	}
+
+	return -1;
+}
+
+/* Entregar la solicitud a la partición dueña de la hora pedida sin esperar la decisión:
+ * la partición responde directamente al agente */
+void enrutar_solicitud(MensajeAgente *mensaje) {
+	// Las horas fuera del día las rechaza la partición del extremo
+	int hora = mensaje->hora_solicitada;
+	if (hora < 0) hora = 0;
+	if (hora > HORAS_DIA - 1) hora = HORAS_DIA - 1;
+	int p = particion_de_hora(hora);
+
+	SolicitudParticion solicitud;
+	memset(&solicitud, 0, sizeof(solicitud));
+	solicitud.tipo = 1;
+	solicitud.mensaje = *mensaje;
+
+	pthread_mutex_lock(&mutex_particiones);
+	int activa = particiones[p].activa;
+	if (activa) {
+		SolicitudPendiente *pendiente = &particiones[p].pendientes[particiones[p].enviadas % MAX_PENDIENTES];
+		strncpy(pendiente->pipe_respuesta, mensaje->pipe_respuesta, sizeof(pendiente->pipe_respuesta) - 1);
+		strncpy(pendiente->familia, mensaje->familia, sizeof(pendiente->familia) - 1);
+		particiones[p].enviadas++;
+	} else {
+		solicitudes_rechazadas++;
+	}
+	pthread_mutex_unlock(&mutex_particiones);
+
+	if (!activa) {
+		char respuesta[BUFFER_SIZE];
+		snprintf(respuesta, sizeof(respuesta), "RESERVA NEGADA: Familia %s - La partición de la hora %d no está disponible", mensaje->familia, mensaje->hora_solicitada);
+		responder_agente(mensaje->pipe_respuesta, respuesta);
+		printf("RESPUESTA ENVIADA: %s\n", respuesta);
+		return;
+	}
+
+	if (write(particiones[p].fd_solicitudes, &solicitud, sizeof(solicitud)) != sizeof(solicitud)) {
+		// La partición terminó: esta solicitud se responde con las demás que tenía pendientes
+		marcar_particion_caida(p, strerror(errno));
+	}
+}
+
+/* Enviar un aviso (AVANZAR o CONFIGURAR) a todas las particiones activas */
+void enviar_a_particiones(SolicitudParticion *solicitud) {
+	for (int p = 0; p < num_particiones; p++) {
+		if (particiones[p].activa && write(particiones[p].fd_solicitudes, solicitud, sizeof(*solicitud)) != sizeof(*solicitud)) {
+			marcar_particion_caida(p, strerror(errno));
+		}
+	}
+}
+
+/* Dejar de usar una partición que terminó. En el coordinador además se rechazan las
+ * solicitudes que le fueron entregadas y que no alcanzó a responder */
+void marcar_particion_caida(int indice, const char *motivo) {
+	Particion *particion = &particiones[indice];
+
+	if (particion_propia >= 0) {
+		if (particion->activa) {
+			particion->activa = 0;
+			fprintf(stderr, "Partición %d: sin comunicación con la partición %d (%s)\n", particion_propia, indice, motivo);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&mutex_particiones);
+
+	if (particion->activa) {
+		particion->activa = 0;
+		printf("PARTICIÓN %d NO DISPONIBLE (pid %d): %s\n", indice, (int)particion->pid, motivo);
+
+		// Las solicitudes se deciden en orden de llegada: las pendientes son las últimas enviadas
+		unsigned long respondidas = __atomic_load_n(&atendidas[indice], __ATOMIC_ACQUIRE);
+		for (unsigned long n = respondidas; n < particion->enviadas; n++) {
+			SolicitudPendiente *pendiente = &particion->pendientes[n % MAX_PENDIENTES];
+			char respuesta[BUFFER_SIZE];
+			snprintf(respuesta, sizeof(respuesta), "RESERVA NEGADA: Familia %s - La partición de la hora solicitada no está disponible", pendiente->familia);
+			responder_sin_espera(pendiente->pipe_respuesta, respuesta);
+			solicitudes_rechazadas++;
+		}
+	}
+
+	pthread_mutex_unlock(&mutex_particiones);
+}
+
+/* Recoger las particiones cuyo proceso terminó (solo en el coordinador) */
+void revisar_particiones() {
+	for (int p = 0; p < num_particiones; p++) {
+		int estado;
+		if (particiones[p].pid > 0 && waitpid(particiones[p].pid, &estado, WNOHANG) == particiones[p].pid) {
+			char motivo[64];
+			if (WIFSIGNALED(estado)) {
+				snprintf(motivo, sizeof(motivo), "terminó por la señal %d", WTERMSIG(estado));
+			} else {
+				snprintf(motivo, sizeof(motivo), "terminó con estado %d", WEXITSTATUS(estado));
+			}
+			marcar_particion_caida(p, motivo);
+			particiones[p].pid = -1;
+		}
+	}
+}
+
+/* Responder a un agente sin quedar bloqueado si ya no espera la respuesta: se reintenta
+ * unos instantes por si aún no abrió su pipe */
+void responder_sin_espera(const char *pipe_respuesta, const char *mensaje) {
+	for (int intento = 0; intento < 10; intento++) {
+		int fd = open(pipe_respuesta, O_WRONLY | O_NONBLOCK);
+		if (fd != -1) {
+			struct stat info;
+			if (fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode)) {
+				write(fd, mensaje, strlen(mensaje) + 1);
+			}
+			close(fd);
+			return;
+		}
+		if (errno != ENXIO) {
+			return;
+		}
+		usleep(50000);
+	}
+}
+
+/* Aplicar una petición en la partición indicada: directo si es la propia, si no por su
+ * pipe de servicio. Devuelve 0 si la aplicó, -1 si la rechazó y -2 si no respondió.
+ * Con -2 la petición pudo haberse aplicado igual: quien llama debe deshacerla */
+int consultar_particion(int indice, MensajeParticion *peticion, RespuestaParticion *respuesta) {
+	peticion->origen = particion_propia >= 0 ? particion_propia : num_particiones;
+
+	if (indice == particion_propia) {
+		pthread_mutex_lock(&mutex_horas);
+		atender_peticion_particion(peticion, respuesta);
+		pthread_mutex_unlock(&mutex_horas);
+		return respuesta->ok ? 0 : -1;
+	}
+
+	if (!particiones[indice].activa) {
+		return -2;
+	}
+
+	peticion->secuencia = ++secuencia_peticiones;
+	if (write(particiones[indice].fd_servicio, peticion, sizeof(*peticion)) != sizeof(*peticion)) {
+		marcar_particion_caida(indice, strerror(errno));
+		return -2;
+	}
+
+	while (1) {
+		struct pollfd pendiente = {fd_mis_respuestas, POLLIN, 0};
+		if (poll(&pendiente, 1, ESPERA_PARTICION_MS) <= 0 || read(fd_mis_respuestas, respuesta, sizeof(*respuesta)) != sizeof(*respuesta)) {
+			// Una respuesta lenta no significa que terminó: eso lo dicen EPIPE y waitpid
+			fprintf(stderr, "Error: La partición %d no respondió a tiempo\n", indice);
+			return -2;
+		}
+
+		if (respuesta->secuencia == peticion->secuencia) {
+			break;
+		}
+		// Respuesta atrasada de una petición que ya se dio por perdida
+	}
+
+	return respuesta->ok ? 0 : -1;
+}
+
+/* Enviar una petición sin esperar la respuesta, que se descarta al llegar porque su
+ * secuencia ya no es la esperada. La usa ABORTAR: el pipe de servicio entrega en orden,
+ * así que la dueña la aplica después del PREPARAR que deshace aunque este no haya
+ * respondido a tiempo */
+void avisar_particion(int indice, MensajeParticion *peticion) {
+	peticion->origen = particion_propia >= 0 ? particion_propia : num_particiones;
+
+	if (indice == particion_propia) {
+		RespuestaParticion respuesta;
+		pthread_mutex_lock(&mutex_horas);
+		atender_peticion_particion(peticion, &respuesta);
+		pthread_mutex_unlock(&mutex_horas);
+		return;
+	}
+
+	if (!particiones[indice].activa) {
+		return;
+	}
+
+	peticion->secuencia = ++secuencia_peticiones;
+	if (write(particiones[indice].fd_servicio, peticion, sizeof(*peticion)) != sizeof(*peticion)) {
+		marcar_particion_caida(indice, strerror(errno));
+	}
+}
+
+/* Reservar la ventana que empieza en hora. Si es toda de la partición propia basta una
+ * llamada local; si no, se usa confirmación en dos fases aunque la dueña sea una sola,
+ * porque una petición remota que no responde a tiempo pudo aplicarse y solo una
+ * retención se puede deshacer sin saber si llegó */
+int reservar_ventana_particiones(const Configuracion *cfg, int hora, int num_personas) {
+	int ultima = hora + HORAS_POR_RESERVA - 1 <= cfg->hora_fin ? hora + HORAS_POR_RESERVA - 1 : cfg->hora_fin;
+	int duenas[HORAS_POR_RESERVA];
+	int num_duenas = 0;
+
+	for (int h = hora; h <= ultima; h++) {
+		int p = particion_de_hora(h);
+		if (p == -1) return 0;
+		if (num_duenas == 0 || duenas[num_duenas - 1] != p) {
+			duenas[num_duenas++] = p;
+		}
+	}
+
+	MensajeParticion peticion;
+	RespuestaParticion respuesta;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.hora = hora;
+	peticion.num_personas = num_personas;
+	peticion.hora_fin = cfg->hora_fin;
+	memcpy(peticion.capacidad, cfg->capacidad_hora, sizeof(peticion.capacidad));
+
+	if (num_duenas == 1 && duenas[0] == particion_propia) {
+		peticion.tipo = 2;
+		return consultar_particion(duenas[0], &peticion, &respuesta) == 0;
+	}
+
+	// Fase 1: cada dueña retiene su parte de la ventana. Las que recibieron el PREPARAR
+	// son las preparadas más la que falló, que pudo retener sin alcanzar a responder
+	int preparadas = 0;
+	peticion.tipo = 3;
+	while (preparadas < num_duenas && consultar_particion(duenas[preparadas], &peticion, &respuesta) == 0) {
+		preparadas++;
+	}
+
+	if (preparadas == num_duenas) {
+		// Fase 2: confirmar. La decisión ya está tomada; una confirmación que tarda en
+		// responder igual se aplica porque llega antes que cualquier otra de este origen
+		peticion.tipo = 4;
+		for (int i = 0; i < num_duenas; i++) {
+			consultar_particion(duenas[i], &peticion, &respuesta);
+		}
+		return 1;
+	}
+
+	// Fase 2: liberar lo retenido, incluida la dueña que no respondió o rechazó
+	peticion.tipo = 5;
+	for (int i = 0; i <= preparadas; i++) {
+		avisar_particion(duenas[i], &peticion);
+	}
+
+	return 0;
+}
+
+/* Reservar en la hora solicitada (si es >= 0) o en la primera alternativa desde
+ * hora_decision, consultando el cupo de todas las particiones. Lo usa el hilo de admisión de
+ * una partición, sin mutex_horas: las horas propias se consultan como las ajenas */
+int reservar_en_particiones(const Configuracion *cfg, int hora_decision, int hora_solicitada, int num_personas) {
+	if (hora_solicitada >= 0 && reservar_ventana_particiones(cfg, hora_solicitada, num_personas)) {
+		return hora_solicitada;
+	}
+
+	if (hora_decision > cfg->hora_fin - 1) {
+		return -1;
+	}
+
+	// Unir las máscaras de cupo de todas las particiones
+	MensajeParticion peticion;
+	RespuestaParticion respuesta;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.tipo = 1;
+	peticion.hora = hora_decision;
+	peticion.num_personas = num_personas;
+	peticion.hora_fin = cfg->hora_fin;
+	memcpy(peticion.capacidad, cfg->capacidad_hora, sizeof(peticion.capacidad));
+
+	uint32_t mascara = 0;
+	for (int p = 0; p < num_particiones; p++) {
+		if (consultar_particion(p, &peticion, &respuesta) == 0) {
+			mascara |= respuesta.mascara;
+		}
+	}
+
+	// Las horas después de hora_fin no restringen la ventana
+	uint32_t libres = mascara | ~((2u << cfg->hora_fin) - 1);
+	uint32_t ventanas = libres;
+	for (int k = 1; k < HORAS_POR_RESERVA; k++) {
+		ventanas &= libres >> k;
+	}
+	ventanas &= ((2u << (cfg->hora_fin - 1)) - 1) & ~((1u << hora_decision) - 1);
+
+	// Probar candidatas en orden; una reserva fallida solo ocurre si el cupo cambió
+	while (ventanas != 0) {
+		int h = __builtin_ctz(ventanas);
+		if (reservar_ventana_particiones(cfg, h, num_personas)) {
+			return h;
+		}
+		ventanas &= ventanas - 1;
+	}
+
+	return -1;
+}
+
+/* Traer a la copia local los contadores de cada partición y, si hora_avance >= 0,
+ * avisarles del cambio de hora. Devuelve cuántas no respondieron; de ellas se
+ * conservan los últimos contadores recibidos. Requiere mutex_horas */
+int sincronizar_particiones(int hora_avance) {
+	MensajeParticion peticion;
+	RespuestaParticion respuesta;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.tipo = 6;
+	int sin_respuesta = 0;
+
+	for (int p = 0; p < num_particiones; p++) {
+		if (consultar_particion(p, &peticion, &respuesta) != 0) {
+			sin_respuesta++;
+			continue;
+		}
+
+		for (int h = particiones[p].desde; h <= particiones[p].hasta; h++) {
+			estado_horas.capacidad_actual[h] = respuesta.capacidad_actual[h];
+			estado_horas.personas_entrando[h] = respuesta.personas_entrando[h];
+			estado_horas.personas_saliendo[h] = respuesta.personas_saliendo[h];
+		}
+		particiones[p].aceptadas = respuesta.aceptadas;
+		particiones[p].reprogramadas = respuesta.reprogramadas;
+		particiones[p].rechazadas = respuesta.rechazadas;
+	}
+
+	if (hora_avance >= 0) {
+		SolicitudParticion aviso;
+		memset(&aviso, 0, sizeof(aviso));
+		aviso.tipo = 2;
+		aviso.hora_actual = hora_avance;
+		enviar_a_particiones(&aviso);
+	}
+
+	return sin_respuesta;
+}
+
+// Responder al agente
+void responder_agente(const char *pipe_respuesta, const char *mensaje) {
+	int fd = open(pipe_respuesta, O_WRONLY);
+	if (fd == -1) {
+		perror("Error abriendo pipe de respuesta del agente");
+		return;
+	}
+
+	// La ruta viene del mensaje: no escribir sobre un archivo que no sea un pipe
+	struct stat info;
+	if (fstat(fd, &info) == -1 || !S_ISFIFO(info.st_mode)) {
+		fprintf(stderr, "Advertencia: %s no es un pipe, no se responde\n", pipe_respuesta);
+		close(fd);
+		return;
+	}
+
+	write(fd, mensaje, strlen(mensaje) + 1);
+	close(fd);
+}
+
+// Avanzar hora de simulación
+void avanzar_hora_simulacion() {
+	hora_actual++;
+
+	// En modo coordinador los contadores viven en las particiones
+	if (num_particiones > 0) {
+		revisar_particiones();
+		int sin_respuesta = sincronizar_particiones(hora_actual);
+		if (sin_respuesta > 0) {
+			printf("Advertencia: %d partición(es) sin responder; sus contadores pueden estar atrasados\n", sin_respuesta);
+		}
+	}
+
+	printf("\n=====| HORA ACTUAL: %d |=====\n", hora_actual);
+
+	// Con hora_fin = 24 el reloj termina en la hora 25, que ya no tiene franja
+	if (hora_actual < HORAS_DIA) {
+		printf("\nPersonas entrando: %d\n", estado_horas.personas_entrando[hora_actual]);
+		printf("Personas saliendo: %d\n", estado_horas.personas_saliendo[hora_actual]);
+		printf("Personas presentes: %d\n", estado_horas.capacidad_actual[hora_actual]);
+	}
+
+	// Resetear contadores de movimiento para la próxima hora
+	if (hora_actual + 1 < HORAS_DIA) {
+		estado_horas.personas_entrando[hora_actual + 1] = 0;
+		estado_horas.personas_saliendo[hora_actual + 1] = 0;
+	}
+
+	// Verificar fin de simulación
+	if (hora_actual >= leer_configuracion()->hora_fin) {
+		printf("=====| FINAL DE LA SIMULACIÓN |=====\n");
+	}
+}
+
+/* Obtener la configuración vigente sin bloquear */
+Configuracion *leer_configuracion() {
+	return __atomic_load_n(&config_actual, __ATOMIC_ACQUIRE);
+}
+
+/* Crear la primera configuración a partir de los parámetros de la línea de comandos */
+Configuracion *crear_configuracion_inicial() {
+	Configuracion *cfg = calloc(1, sizeof(Configuracion));
+	if (cfg == NULL) {
+		perror("Error reservando configuración");
+		exit(1);
+	}
+
+	cfg->hora_fin = hora_fin;
+	cfg->segundos_por_hora = segundos_por_hora;
+	cfg->capacidad_maxima = capacidad_maxima;
+	for (int h = 0; h < HORAS_DIA; h++) {
+		cfg->capacidad_hora[h] = capacidad_maxima;
+	}
+
+	return cfg;
+}
+
+/* Publicar una nueva versión. La anterior se retira pero no se libera: un lector
+ * puede seguir usándola, y las recargas son tan poco frecuentes que basta con
+ * liberarlas al terminar */
+void publicar_configuracion(Configuracion *nueva) {
+	pthread_mutex_lock(&mutex_configuracion);
+
+	Configuracion *anterior = config_actual;
+	nueva->anterior = anterior;
+	nueva->version = anterior != NULL ? anterior->version + 1 : 1;
+
+	// Recalcular la mayor capacidad para la validación de tamaño de grupo. Solo cuentan
+	// las horas del horario: una hora cerrada con más capacidad dejaría pasar grupos
+	// que no caben en ninguna hora abierta
+	nueva->capacidad_maxima = 0;
+	for (int h = hora_inicio; h <= nueva->hora_fin; h++) {
+		if (nueva->capacidad_hora[h] > nueva->capacidad_maxima) {
+			nueva->capacidad_maxima = nueva->capacidad_hora[h];
+		}
+	}
+
+	__atomic_store_n(&config_actual, nueva, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&mutex_configuracion);
+}
+
+/* Leer archivo de configuración con líneas clave=valor sobre una copia de la configuración:
+ *   hora_fin=20
+ *   segundos_por_hora=5
+ *   capacidad=120          (todas las horas)
+ *   capacidad_hora=12:150  (una hora)
+ */
+int cargar_archivo_configuracion(const char *archivo, Configuracion *cfg) {
+	FILE *f = fopen(archivo, "r");
+	if (f == NULL) {
+		perror("Error abriendo archivo de configuración");
+		return -1;
+	}
+
+	char linea[BUFFER_SIZE];
+	int num_linea = 0;
+	int error = 0;
+
+	while (fgets(linea, sizeof(linea), f)) {
+		num_linea++;
+		linea[strcspn(linea, "\r\n")] = 0;
+
+		// Saltar comentarios y líneas vacías
+		if (linea[0] == '#' || strlen(linea) == 0) continue;
+
+		int hora, valor;
+		if (sscanf(linea, "hora_fin=%d", &valor) == 1) {
+			cfg->hora_fin = valor;
+		} else if (sscanf(linea, "segundos_por_hora=%d", &valor) == 1) {
+			cfg->segundos_por_hora = valor;
+		} else if (sscanf(linea, "capacidad_hora=%d:%d", &hora, &valor) == 2) {
+			if (hora < 0 || hora >= HORAS_DIA || valor < 0) {
+				fprintf(stderr, "Error: Capacidad inválida en línea %d: %s\n", num_linea, linea);
+				error = 1;
+				continue;
+			}
+			cfg->capacidad_hora[hora] = valor;
+		} else if (sscanf(linea, "capacidad=%d", &valor) == 1) {
+			if (valor <= 0) {
+				fprintf(stderr, "Error: Capacidad inválida en línea %d: %s\n", num_linea, linea);
+				error = 1;
+				continue;
+			}
+			for (int h = 0; h < HORAS_DIA; h++) {
+				cfg->capacidad_hora[h] = valor;
+			}
+		} else {
+			fprintf(stderr, "Error: Línea de configuración desconocida %d: %s\n", num_linea, linea);
+			error = 1;
+		}
+	}
+
+	fclose(f);
+
+	if (cfg->hora_fin < 1 || cfg->hora_fin > 24 || cfg->hora_fin <= hora_inicio || cfg->hora_fin < hora_actual) {
+		fprintf(stderr, "Error: hora_fin inválida (%d). Debe estar entre 1-24, ser mayor que hora_inicio y no anterior a la hora actual\n", cfg->hora_fin);
+		error = 1;
+	}
+
+	if (cfg->segundos_por_hora <= 0) {
+		fprintf(stderr, "Error: segundos_por_hora debe ser positivo\n");
+		error = 1;
+	}
+
+	return error ? -1 : 0;
+}
+
+/* Construir una nueva versión desde el archivo y publicarla; si falla se conserva la vigente */
+int recargar_configuracion() {
+	Configuracion *nueva = malloc(sizeof(Configuracion));
+	if (nueva == NULL) {
+		perror("Error reservando configuración");
+		return -1;
+	}
+
+	Configuracion *vigente = leer_configuracion();
+	*nueva = *vigente;
+
+	if (cargar_archivo_configuracion(archivo_configuracion, nueva) == -1) {
+		fprintf(stderr, "Error: Configuración no recargada, se mantiene la versión %lu\n", vigente->version);
+		free(nueva);
+		return -1;
+	}
+
+	publicar_configuracion(nueva);
+
+	// Dejar constancia de los cambios en la traza para que la reproducción los aplique.
+	// Pueden quedar detrás de solicitudes ya decididas con esta versión: la reproducción
+	// las ordena por versión
+	MensajeAgente cambio;
+	memset(&cambio, 0, sizeof(cambio));
+	for (int h = 0; h < HORAS_DIA; h++) {
+		if (nueva->capacidad_hora[h] != vigente->capacidad_hora[h]) {
+			cambio.hora_solicitada = h;
+			cambio.num_personas = nueva->capacidad_hora[h];
+			escribir_registro_traza(&cambio, 4, nueva->version, hora_actual, 0, -1);
+		}
+	}
+	if (nueva->hora_fin != vigente->hora_fin || nueva->segundos_por_hora != vigente->segundos_por_hora) {
+		cambio.hora_solicitada = nueva->hora_fin;
+		cambio.num_personas = nueva->segundos_por_hora;
+		escribir_registro_traza(&cambio, 5, nueva->version, hora_actual, 0, -1);
+	}
+
+	// Las particiones aplican la nueva versión en orden con sus solicitudes
+	if (num_particiones > 0) {
+		SolicitudParticion aviso;
+		memset(&aviso, 0, sizeof(aviso));
+		aviso.tipo = 3;
+		aviso.hora_fin = nueva->hora_fin;
+		memcpy(aviso.capacidad, nueva->capacidad_hora, sizeof(aviso.capacidad));
+		enviar_a_particiones(&aviso);
+	}
+
+	printf("CONFIGURACIÓN RECARGADA (versión %lu): Hora fin %d, Segundos por hora %d, Capacidad máxima %d\n",
+	nueva->version, nueva->hora_fin, nueva->segundos_por_hora, nueva->capacidad_maxima);
+	return 0;
+}
+
+/* Hilo que atiende las señales con sigwait: SIGHUP recarga la configuración y
+ * SIGINT/SIGTERM piden terminar. El reporte y la limpieza quedan a cargo de main,
+ * fuera de cualquier manejador de señales */
+void *hilo_senales(void *arg) {
+	sigset_t senales;
+	sigemptyset(&senales);
+	sigaddset(&senales, SIGHUP);
+	sigaddset(&senales, SIGINT);
+	sigaddset(&senales, SIGTERM);
+
+	while (1) {
+		int sig;
+		if (sigwait(&senales, &sig) != 0) continue;
+
+		if (sig == SIGHUP) {
+			if (strlen(archivo_configuracion) == 0) {
+				printf("SIGHUP ignorada: no se indicó archivo de configuración (-c)\n");
+			} else if (running) {
+				printf("\n=====| SIGHUP RECIBIDA: RECARGANDO %s |=====\n", archivo_configuracion);
+				recargar_configuracion();
+			}
+			continue;
+		}
+
+		// main también envía SIGTERM a este hilo al terminar la simulación
+		if (running) {
+			printf("\n=====| SEÑAL DE TERMINACIÓN RECIBIDA |=====\n");
+		}
+		detener_simulacion();
+		return NULL;
+	}
+}
+
+/* Liberar la configuración vigente y todas las retiradas. Solo después de detener
+ * los hilos: cualquiera de ellos puede estar leyendo config_actual */
+void liberar_configuraciones() {
+	pthread_mutex_lock(&mutex_configuracion);
+
+	Configuracion *cfg = __atomic_exchange_n(&config_actual, NULL, __ATOMIC_ACQ_REL);
+	while (cfg != NULL) {
+		Configuracion *temp = cfg;
+		cfg = cfg->anterior;
+		free(temp);
+	}
+
+	pthread_mutex_unlock(&mutex_configuracion);
+}
+
+/* Abrir archivo de traza y escribir la cabecera con la configuración actual */
+int abrir_traza(const char *archivo) {
+	archivo_traza = fopen(archivo, "wb");
+	if (archivo_traza == NULL) {
+		perror("Error creando archivo de traza");
+		return -1;
+	}
+
+	const Configuracion *cfg = leer_configuracion();
+
+	CabeceraTraza cabecera;
+	memcpy(cabecera.magia, "TRZ2", sizeof(cabecera.magia));
+	cabecera.hora_inicio = hora_inicio;
+	cabecera.hora_fin = cfg->hora_fin;
+	cabecera.segundos_por_hora = cfg->segundos_por_hora;
+	cabecera.capacidad_maxima = cfg->capacidad_maxima;
+
+	if (fwrite(&cabecera, sizeof(cabecera), 1, archivo_traza) != 1) {
+		perror("Error escribiendo cabecera de traza");
+		fclose(archivo_traza);
+		archivo_traza = NULL;
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio_traza);
+
+	// Las horas con capacidad propia se graban como recargas iniciales
+	MensajeAgente cambio;
+	memset(&cambio, 0, sizeof(cambio));
+	for (int h = 0; h < HORAS_DIA; h++) {
+		if (cfg->capacidad_hora[h] != cfg->capacidad_maxima) {
+			cambio.hora_solicitada = h;
+			cambio.num_personas = cfg->capacidad_hora[h];
+			escribir_registro_traza(&cambio, 4, cfg->version, hora_actual, 0, -1);
+		}
+	}
+
+	return 0;
+}
+
+/* Registrar en la traza un mensaje recibido junto con su decisión */
+void registrar_traza(MensajeAgente *mensaje, unsigned long version, int hora_decision, int decision, int hora_asignada) {
+	int tipo = 0;
+
+	if (strcmp(mensaje->tipo, "REGISTRO") == 0) {
+		tipo = 1;
+	} else if (strcmp(mensaje->tipo, "RESERVA") == 0) {
+		tipo = 2;
+	} else if (strcmp(mensaje->tipo, "DEREGISTRO") == 0) {
+		tipo = 3;
+	}
+
+	escribir_registro_traza(mensaje, tipo, version, hora_decision, decision, hora_asignada);
+}
+
+/* Escribir un registro de la traza con un tipo explícito */
+void escribir_registro_traza(MensajeAgente *mensaje, int tipo, unsigned long version, int hora_decision, int decision, int hora_asignada) {
+	if (archivo_traza == NULL) return;
+
+	struct timespec ahora;
+	clock_gettime(CLOCK_MONOTONIC, &ahora);
+
+	RegistroTraza registro;
+	memset(&registro, 0, sizeof(registro));
+	registro.marca_ns = (uint64_t)(ahora.tv_sec - inicio_traza.tv_sec) * 1000000000ULL + ahora.tv_nsec - inicio_traza.tv_nsec;
+	registro.hora_solicitada = mensaje->hora_solicitada;
+	registro.num_personas = mensaje->num_personas;
+	registro.version = version;
+	registro.hora_actual = hora_decision;
+	registro.hora_asignada = hora_asignada;
+	registro.decision = decision;
+	registro.tipo = tipo;
+
+	strncpy(registro.familia, mensaje->familia, sizeof(registro.familia) - 1);
+	strncpy(registro.nombre_agente, mensaje->nombre_agente, sizeof(registro.nombre_agente) - 1);
+
+	// Vaciar en cada registro: una caída no pierde la cola de la traza
+	if (fwrite(&registro, sizeof(registro), 1, archivo_traza) != 1 || fflush(archivo_traza) != 0) {
+		perror("Error escribiendo traza");
+	}
+}
+
+/* Verificar que las horas de un registro estén dentro de los arreglos y del horario
+ * de la traza (la cabecera ya fue validada) */
+int registro_traza_valido(const RegistroTraza *registro) {
+	switch (registro->tipo) {
+	case 2:
+		// El reloj llega hasta hora_fin + 1
+		return registro->hora_actual >= hora_inicio && registro->hora_actual <= HORAS_DIA;
+	case 4:
+		return registro->hora_solicitada >= 0 && registro->hora_solicitada < HORAS_DIA && registro->num_personas >= 0;
+	case 5:
+		return registro->hora_solicitada >= 1 && registro->hora_solicitada <= 24 && registro->hora_solicitada > hora_inicio &&
+		       registro->num_personas > 0;
+	default:
+		return 1;
+	}
+}
+
+/* Reproducir una traza sin pipes ni reloj, a máxima velocidad, comparando decisiones */
+int reproducir_traza(const char *archivo) {
+	FILE *traza = fopen(archivo, "rb");
+	if (traza == NULL) {
+		perror("Error abriendo archivo de traza");
+		return 1;
+	}
+
+	CabeceraTraza cabecera;
+	if (fread(&cabecera, sizeof(cabecera), 1, traza) != 1 || memcmp(cabecera.magia, "TRZ2", sizeof(cabecera.magia)) != 0) {
+		fprintf(stderr, "Error: %s no es un archivo de traza válido\n", archivo);
+		fclose(traza);
+		return 1;
+	}
+
+	// Mismas reglas que los parámetros de main: la traza puede venir alterada
+	if (cabecera.hora_inicio < 1 || cabecera.hora_inicio > 24 || cabecera.hora_fin < 1 || cabecera.hora_fin > 24 ||
+	    cabecera.hora_fin <= cabecera.hora_inicio || cabecera.segundos_por_hora <= 0 || cabecera.capacidad_maxima <= 0) {
+		fprintf(stderr, "Error: Cabecera de traza inválida en %s\n", archivo);
+		fclose(traza);
+		return 1;
+	}
+
+	// La configuración de la traza reemplaza la de la línea de comandos
+	hora_inicio = cabecera.hora_inicio;
+	hora_fin = cabecera.hora_fin;
+	segundos_por_hora = cabecera.segundos_por_hora;
+	capacidad_maxima = cabecera.capacidad_maxima;
+	hora_actual = hora_inicio;
+	inicializar_horas();
+	publicar_configuracion(crear_configuracion_inicial());
+
+	printf("=====| REPRODUCIENDO TRAZA: %s |=====\n", archivo);
+	printf("Hora inicio: %d, Hora fin: %d, Capacidad máxima por hora: %d\n", hora_inicio, hora_fin, capacidad_maxima);
+
+	RegistroTraza registro;
+	long mensajes = 0, solicitudes = 0, divergencias = 0, invalidos = 0;
+	char respuesta[BUFFER_SIZE];
+	struct timespec inicio, fin;
+
+	// Primera pasada: separar las recargas. Se graban después de publicar la versión,
+	// así que pueden aparecer detrás de solicitudes que ya se decidieron con ella
+	RegistroTraza *recargas = NULL;
+	long num_recargas = 0, capacidad_recargas = 0;
+
+	while (fread(&registro, sizeof(registro), 1, traza) == 1) {
+		mensajes++;
+
+		if (!registro_traza_valido(&registro)) {
+			if (invalidos < MAX_DIVERGENCIAS) {
+				fprintf(stderr, "Advertencia: Registro %ld de la traza fuera de rango, se omite\n", mensajes);
+			}
+			invalidos++;
+			continue;
+		}
+
+		if (registro.tipo == 4 || registro.tipo == 5) {
+			if (num_recargas == capacidad_recargas) {
+				capacidad_recargas = capacidad_recargas > 0 ? capacidad_recargas * 2 : 16;
+				RegistroTraza *ampliado = realloc(recargas, capacidad_recargas * sizeof(RegistroTraza));
+				if (ampliado == NULL) {
+					perror("Error reservando recargas de la traza");
+					free(recargas);
+					fclose(traza);
+					liberar_configuraciones();
+					return 1;
+				}
+				recargas = ampliado;
+			}
+			recargas[num_recargas++] = registro;
+		}
+	}
+
+	fseek(traza, sizeof(cabecera), SEEK_SET);
+	long siguiente_recarga = 0;
+	long numero = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+	while (fread(&registro, sizeof(registro), 1, traza) == 1) {
+		numero++;
+
+		if (registro.tipo != 2 || !registro_traza_valido(&registro)) continue;
+
+		// Publicar de una vez las recargas hasta la versión con que se decidió la solicitud
+		if (siguiente_recarga < num_recargas && recargas[siguiente_recarga].version <= registro.version) {
+			Configuracion *nueva = malloc(sizeof(Configuracion));
+			if (nueva == NULL) break;
+			*nueva = *leer_configuracion();
+
+			for (; siguiente_recarga < num_recargas && recargas[siguiente_recarga].version <= registro.version; siguiente_recarga++) {
+				const RegistroTraza *recarga = &recargas[siguiente_recarga];
+				if (recarga->tipo == 4) {
+					nueva->capacidad_hora[recarga->hora_solicitada] = recarga->num_personas;
+				} else {
+					nueva->hora_fin = recarga->hora_solicitada;
+					nueva->segundos_por_hora = recarga->num_personas;
+				}
+			}
+
+			publicar_configuracion(nueva);
+		}
+
+		MensajeAgente mensaje;
+		memset(&mensaje, 0, sizeof(mensaje));
+		strncpy(mensaje.tipo, "RESERVA", sizeof(mensaje.tipo));
+		strncpy(mensaje.nombre_agente, registro.nombre_agente, sizeof(mensaje.nombre_agente) - 1);
+		strncpy(mensaje.familia, registro.familia, sizeof(mensaje.familia) - 1);
+		mensaje.hora_solicitada = registro.hora_solicitada;
+		mensaje.num_personas = registro.num_personas;
+
+		// Se decide con la hora que usó la decisión grabada
+		int hora_asignada;
+		int decision = decidir_reserva(leer_configuracion(), registro.hora_actual, &mensaje, respuesta, sizeof(respuesta), &hora_asignada);
+		solicitudes++;
+
+		if (decision != registro.decision || hora_asignada != registro.hora_asignada) {
+			if (divergencias < MAX_DIVERGENCIAS) {
+				printf("DIVERGENCIA mensaje %ld: Familia %s, Hora %d, Personas %d - grabado %d (hora %d), reproducido %d (hora %d)\n",
+				numero, mensaje.familia, mensaje.hora_solicitada, mensaje.num_personas,
+				registro.decision, registro.hora_asignada, decision, hora_asignada);
+			}
+			divergencias++;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+	fclose(traza);
+	free(recargas);
+
+	double segundos = (fin.tv_sec - inicio.tv_sec) + (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+
+	printf("\nMensajes leídos: %ld\n", mensajes);
+	printf("Solicitudes reproducidas: %ld\n", solicitudes);
+	printf("Decisiones divergentes: %ld\n", divergencias);
+	if (invalidos > 0) {
+		printf("Registros inválidos omitidos: %ld\n", invalidos);
+	}
+	printf("Tiempo de admisión: %.6f s (%.0f solicitudes/s)\n", segundos, segundos > 0 ? solicitudes / segundos : 0.0);
+
+	generar_reporte_final();
+
+	// Liberar reservas creadas durante la reproducción
+	Reserva *reserva_actual = lista_reservas;
+	while (reserva_actual != NULL) {
+		Reserva *temp = reserva_actual;
+		reserva_actual = reserva_actual->siguiente;
+		free(temp);
+	}
+	lista_reservas = NULL;
+	liberar_configuraciones();
+
+	return divergencias > 0 ? 2 : 0;
+}
+
+/* Agregar reserva a la lista */
+void agregar_reserva(const char *familia, const char *agente, int hora_entrada, int num_personas, int estado) {
+	pthread_mutex_lock(&mutex_reservas);
+
+	Reserva *nueva_reserva = malloc(sizeof(Reserva));
+	strncpy(nueva_reserva->familia, familia, sizeof(nueva_reserva->familia));
+	strncpy(nueva_reserva->agente, agente, sizeof(nueva_reserva->agente));
+	nueva_reserva->hora_entrada = hora_entrada;
+	nueva_reserva->num_personas = num_personas;
+	nueva_reserva->estado = estado;
+	nueva_reserva->siguiente = lista_reservas;
+	lista_reservas = nueva_reserva;
+
+	pthread_mutex_unlock(&mutex_reservas);
+}
+
+/* Generar reporte final */
+void generar_reporte_final() {
+	printf("\n=====| REPORTE FINAL DEL SISTEMA DE RESERVAS |=====\n");
+
+	const Configuracion *cfg = leer_configuracion();
+	int hora_fin = cfg->hora_fin;
+
+	int aceptadas = solicitudes_aceptadas;
+	int reprogramadas = solicitudes_reprogramadas;
+	int rechazadas = solicitudes_rechazadas;
+
+	// En modo coordinador los contadores viven en las particiones. main genera el
+	// reporte con los demás hilos detenidos, así que la consulta no compite con nadie
+	if (num_particiones > 0) {
+		pthread_mutex_lock(&mutex_horas);
+		revisar_particiones();
+		int sin_respuesta = sincronizar_particiones(-1);
+		pthread_mutex_unlock(&mutex_horas);
+
+		if (sin_respuesta > 0) {
+			printf("Advertencia: %d partición(es) sin responder; se usan sus últimos contadores conocidos\n", sin_respuesta);
+		}
+
+		for (int p = 0; p < num_particiones; p++) {
+			aceptadas += particiones[p].aceptadas;
+			reprogramadas += particiones[p].reprogramadas;
+			rechazadas += particiones[p].rechazadas;
+		}
+	}
+
+	// Calcular horas pico y horas bajas
+	int max_personas = 0;
+	int min_personas = estado_horas.capacidad_actual[hora_inicio];
+	int horas_pico[HORAS_DIA], num_horas_pico = 0;
+	int horas_bajas[HORAS_DIA], num_horas_bajas = 0;
+
+	for (int i = hora_inicio; i <= hora_fin; i++) {
+		if (estado_horas.capacidad_actual[i] > max_personas) {
+			max_personas = estado_horas.capacidad_actual[i];
+			num_horas_pico = 0;
+			horas_pico[num_horas_pico++] = i;
+		} else if (estado_horas.capacidad_actual[i] == max_personas) {
+			horas_pico[num_horas_pico++] = i;
+		}
+
+		if (estado_horas.capacidad_actual[i] < min_personas) {
+			min_personas = estado_horas.capacidad_actual[i];
+			num_horas_bajas = 0;
+			horas_bajas[num_horas_bajas++] = i;
+		} else if (estado_horas.capacidad_actual[i] == min_personas) {
+			horas_bajas[num_horas_bajas++] = i;
+		}
+	}
+
+	/* Imprimir estadísticas */
+	printf("\n=====| ESTADÍSTICAS DE SOLICITUDES |=====\n\n");
+	printf("Solicitudes aceptadas en hora solicitada: %d\n", aceptadas);
+	printf("Solicitudes reprogramadas: %d\n", reprogramadas);
+	printf("Solicitudes rechazadas: %d\n", rechazadas);
+	printf("Total de solicitudes procesadas: %d\n", aceptadas + reprogramadas + rechazadas);
+	if (num_particiones > 0) {
+		printf("Caché de admisión: desactivada en modo coordinador\n");
+	} else {
+		printf("Caché de admisión: %d aciertos, %d fallos\n", aciertos_cache, fallos_cache);
+	}
+
+	printf("\n=====| ANÁLISIS DE OCUPACIÓN |=====\n\n");
+	printf("Horas pico (%d personas): ", max_personas);
+	for (int i = 0; i < num_horas_pico; i++) {
+		printf("%d ", horas_pico[i]);
+	}
+	printf("\n");
+
+	printf("Horas de menor afluencia (%d personas): ", min_personas);
+	for (int i = 0; i < num_horas_bajas; i++) {
+		printf("%d ", horas_bajas[i]);
+	}
+	printf("\n");
+
+	printf("\n=====| RESUMEN POR HORA |=====\n\n");
+	for (int i = hora_inicio; i <= hora_fin; i++) {
+		printf("Hora %d: %d personas (de %d máximo)\n", i, estado_horas.capacidad_actual[i], cfg->capacidad_hora[i]);
+	}
 
 	printf("\n=====| FIN DEL REPORTE |=====\n");
 }
 
 int main(int argc, char *argv[]) {
-	// Configurar manejador de señales
-	signal(SIGINT, manejar_senal);
-	signal(SIGTERM, manejar_senal);
-
 	// Valores por defecto
 	hora_inicio = 7;
 	hora_fin = 19;
 	segundos_por_hora = 10;
 	capacidad_maxima = 100;
 	strcpy(pipe_controlador, "/tmp/pipe_controlador");
+	char archivo_grabacion[100] = "";
+	char archivo_reproduccion[100] = "";
+	int iteraciones_medicion = 0;
+	int cantidad_particiones = 0;
 
 	// Parseo de argumentos
 	int i = 1;
@@ -511,13 +2471,42 @@ int main(int argc, char *argv[]) {
 		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
 			strncpy(pipe_controlador, argv[i + 1], sizeof(pipe_controlador) - 1);
 			i += 2;
+		} else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+			strncpy(archivo_grabacion, argv[i + 1], sizeof(archivo_grabacion) - 1);
+			i += 2;
+		} else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			strncpy(archivo_configuracion, argv[i + 1], sizeof(archivo_configuracion) - 1);
+			i += 2;
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			cantidad_particiones = atoi(argv[i + 1]);
+			i += 2;
+		} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			iteraciones_medicion = atoi(argv[i + 1]);
+			i += 2;
+		} else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+			strncpy(archivo_reproduccion, argv[i + 1], sizeof(archivo_reproduccion) - 1);
+			i += 2;
 		} else {
-			fprintf(stderr, "Uso: %s -i hora_inicio -f hora_fin -s segundos_por_hora -t capacidad_maxima -p pipe_controlador\n", argv[0]);
-			fprintf(stderr, "Ejemplo: %s -i 7 -f 19 -s 10 -t 100 -p /tmp/pipe_controlador\n", argv[0]);
+			fprintf(stderr, "Uso: %s -i hora_inicio -f hora_fin -s segundos_por_hora -t capacidad_maxima -p pipe_controlador [-c archivo_configuracion] [-g archivo_traza] [-n particiones]\n", argv[0]);
+			fprintf(stderr, "     %s -R archivo_traza\n", argv[0]);
+			fprintf(stderr, "     %s -b iteraciones\n", argv[0]);
+			fprintf(stderr, "Ejemplo: %s -i 7 -f 19 -s 10 -t 100 -p /tmp/pipe_controlador -g traza.bin\n", argv[0]);
 			return 1;
 		}
 	}
 
+	// Modo medición del kernel de búsqueda de cupo
+	if (iteraciones_medicion > 0) {
+		return medir_busqueda_cupo(iteraciones_medicion);
+	}
+
+	seleccionar_kernel_cupo();
+
+	// Modo reproducción: no crea pipes ni hilos
+	if (strlen(archivo_reproduccion) > 0) {
+		return reproducir_traza(archivo_reproduccion);
+	}
+
 	// Validación de parámetros
 	if (hora_inicio < 1 || hora_inicio > 24 || hora_fin < 1 || hora_fin > 24 || hora_fin <= hora_inicio) {
 		fprintf(stderr, "Error: Horas inválidas. Deben estar entre 1-24 y hora_fin > hora_inicio\n");
@@ -529,44 +2518,124 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
+	if (cantidad_particiones < 0 || cantidad_particiones > MAX_PARTICIONES) {
+		fprintf(stderr, "Error: El número de particiones debe estar entre 0 y %d\n", MAX_PARTICIONES);
+		return 1;
+	}
+
+	if (cantidad_particiones > 0 && strlen(archivo_grabacion) > 0) {
+		fprintf(stderr, "Error: La traza (-g) no está disponible con particiones (-n): las decisiones se toman en cada partición\n");
+		return 1;
+	}
+
+	// Primera versión de la configuración; el archivo (si se indicó) tiene prioridad
+	hora_actual = hora_inicio;
+	Configuracion *cfg = crear_configuracion_inicial();
+	if (strlen(archivo_configuracion) > 0 && cargar_archivo_configuracion(archivo_configuracion, cfg) == -1) {
+		free(cfg);
+		return 1;
+	}
+	publicar_configuracion(cfg);
+
 	// Mostrar configuración
 	printf("=====| INICIANDO CONTROLADOR |=====\n");
 	printf("Hora inicio: %d\n", hora_inicio);
-	printf("Hora fin: %d\n", hora_fin);
-	printf("Segundos por hora de simulación: %d\n", segundos_por_hora);
-	printf("Capacidad máxima por hora: %d\n", capacidad_maxima);
+	printf("Hora fin: %d\n", cfg->hora_fin);
+	printf("Segundos por hora de simulación: %d\n", cfg->segundos_por_hora);
+	printf("Capacidad máxima por hora: %d\n", cfg->capacidad_maxima);
 	printf("Pipe del controlador: %s\n", pipe_controlador);
+	if (strlen(archivo_configuracion) > 0) {
+		printf("Archivo de configuración: %s (recarga con SIGHUP)\n", archivo_configuracion);
+	}
+
+	// Bloquear las señales en todos los hilos; solo el hilo de señales las atiende con sigwait.
+	// Se hace antes de crear las particiones para que una señal temprana no deje pipes
+	sigset_t senales;
+	sigemptyset(&senales);
+	sigaddset(&senales, SIGHUP);
+	sigaddset(&senales, SIGINT);
+	sigaddset(&senales, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &senales, NULL);
+
+	// Un lector que desaparece (partición o agente) se detecta con EPIPE en vez de terminar el proceso
+	signal(SIGPIPE, SIG_IGN);
 
 	// Inicializar sistema
-	hora_actual = hora_inicio;
 	inicializar_sistema();
 
+	// Los procesos de partición se crean antes que cualquier hilo
+	if (cantidad_particiones > 0) {
+		printf("Modo coordinador con %d particiones\n", cantidad_particiones);
+		if (iniciar_particiones(cantidad_particiones) == -1) {
+			limpiar_sistema();
+			liberar_configuraciones();
+			return 1;
+		}
+	}
+
+	if (strlen(archivo_grabacion) > 0) {
+		if (abrir_traza(archivo_grabacion) == -1) {
+			limpiar_sistema();
+			liberar_configuraciones();
+			return 1;
+		}
+		printf("Grabando traza en: %s\n", archivo_grabacion);
+	}
+
 	// Crear hilos
-	pthread_t hilo_receptor, hilo_reloj;
+	pthread_t hilo_receptor, hilo_reloj, hilo_senal;
 
-	if (pthread_create(&hilo_receptor, NULL, hilo_receptor_agentes, NULL) != 0) {
-		perror("Error creando hilo receptor de agentes");
+	if (pthread_create(&hilo_senal, NULL, hilo_senales, NULL) != 0) {
+		perror("Error creando hilo de señales");
 		limpiar_sistema();
+		liberar_configuraciones();
 		return 1;
 	}
 
-	if (pthread_create(&hilo_reloj, NULL, hilo_reloj_simulacion, NULL) != 0) {
-		perror("Error creando hilo del reloj");
-		running = 0;
-		pthread_join(hilo_receptor, NULL);
+	receptor_activo = 1;
+	if (pthread_create(&hilo_receptor, NULL, hilo_receptor_agentes, NULL) != 0) {
+		perror("Error creando hilo receptor de agentes");
+		receptor_activo = 0;
+		pthread_kill(hilo_senal, SIGTERM);
+		pthread_join(hilo_senal, NULL);
 		limpiar_sistema();
+		liberar_configuraciones();
 		return 1;
 	}
 
-	printf("Sistema inicializado correctamente. Esperando agentes...\n");
+	int reloj_creado = pthread_create(&hilo_reloj, NULL, hilo_reloj_simulacion, NULL) == 0;
+	if (!reloj_creado) {
+		perror("Error creando hilo del reloj");
+	} else {
+		printf("Sistema inicializado correctamente. Esperando agentes...\n");
 
-	// Esperar a que terminen los hilos
-	pthread_join(hilo_reloj, NULL);
-	running = 0;
+		// Termina al pasar hora_fin o al recibir SIGINT/SIGTERM
+		pthread_join(hilo_reloj, NULL);
+	}
+
+	// Detener al receptor; se reintenta por si el pipe estaba lleno en un intento
+	detener_simulacion();
+	while (receptor_activo) {
+		despertar_receptor();
+		usleep(100000);
+	}
 	pthread_join(hilo_receptor, NULL);
 
-	// Limpieza final
+	// El hilo de señales sigue en sigwait si la simulación terminó sola
+	pthread_kill(hilo_senal, SIGTERM);
+	pthread_join(hilo_senal, NULL);
+
+	if (!reloj_creado) {
+		limpiar_sistema();
+		liberar_configuraciones();
+		return 1;
+	}
+
+	// Con todos los hilos detenidos el reporte y la limpieza no compiten con nadie;
+	// la configuración se libera al final porque el reporte todavía la lee
+	generar_reporte_final();
 	limpiar_sistema();
+	liberar_configuraciones();
 	printf("Controlador terminado correctamente.\n");
 
 	return 0;